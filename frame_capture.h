@@ -0,0 +1,213 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+
+// Streams rendered frames to disk on a background thread. Frames are copied
+// into a fixed pool of buffers handed between threads through lock-free
+// queues, so the caller is never blocked by the writer. When every buffer is
+// busy the writer is told to repeat the previous frame instead, keeping the
+// output in step with the fixed frame rate; only if that backlog is full too
+// is the frame lost.
+//
+// A path ending in ".y4m" produces one YUV4MPEG2 (4:2:0) stream; any other
+// path is used as a prefix for a numbered PPM sequence (path_000000.ppm, ...).
+class FrameCapture {
+private:
+    int width, height, fpsNum, fpsDen;
+    std::string path;
+    bool y4m;
+    FILE* stream;
+
+    // Enumerators rather than static const members: tryEnqueue() takes a
+    // reference, which would need an out-of-class definition in C++11
+    enum { REPEAT_FRAME = -1 }; // Queued in place of a buffer index
+    enum { REPEAT_SLOTS = 256 };
+
+    std::vector<std::vector<uint32_t> > buffers; // 0x00RRGGBB pixels, tightly packed
+    ConcurrentQueue<int> freeBuffers;
+    ConcurrentQueue<int> readyBuffers;
+
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> repeated;
+    std::atomic<uint64_t> dropped;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::thread writer;
+
+    std::vector<uint8_t> scratch; // Last converted frame, reused for repeats
+
+    // Converts and writes a frame; px = nullptr writes the previous one again
+    void writeY4M(const uint32_t* px) {
+        if (px) convertY4M(px);
+        std::fputs("FRAME\n", stream);
+        std::fwrite(scratch.data(), 1, width * height + 2 * (width / 2) * (height / 2), stream);
+    }
+
+    void convertY4M(const uint32_t* px) {
+        uint8_t* yPlane = scratch.data();
+        uint8_t* uPlane = yPlane + width * height;
+        uint8_t* vPlane = uPlane + (width / 2) * (height / 2);
+
+        // BT.601 full range, chroma averaged over each 2x2 block
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint32_t p = px[y * width + x];
+                int r = (p >> 16) & 0xFF, g = (p >> 8) & 0xFF, b = p & 0xFF;
+                yPlane[y * width + x] = (uint8_t)((77 * r + 150 * g + 29 * b) >> 8);
+            }
+        }
+        for (int y = 0; y < height / 2; y++) {
+            for (int x = 0; x < width / 2; x++) {
+                int r = 0, g = 0, b = 0;
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        uint32_t p = px[(2 * y + dy) * width + 2 * x + dx];
+                        r += (p >> 16) & 0xFF; g += (p >> 8) & 0xFF; b += p & 0xFF;
+                    }
+                }
+                r /= 4; g /= 4; b /= 4;
+                uPlane[y * (width / 2) + x] = (uint8_t)((-43 * r - 85 * g + 128 * b + 32768) >> 8);
+                vPlane[y * (width / 2) + x] = (uint8_t)((128 * r - 107 * g - 21 * b + 32768) >> 8);
+            }
+        }
+    }
+
+    void writePPM(const uint32_t* px, uint64_t index) {
+        if (px) {
+            for (int i = 0; i < width * height; i++) {
+                scratch[3 * i] = (px[i] >> 16) & 0xFF;
+                scratch[3 * i + 1] = (px[i] >> 8) & 0xFF;
+                scratch[3 * i + 2] = px[i] & 0xFF;
+            }
+        }
+
+        char name[512];
+        std::snprintf(name, sizeof(name), "%s_%06llu.ppm", path.c_str(), (unsigned long long)index);
+        FILE* f = std::fopen(name, "wb");
+        if (!f) return;
+
+        std::fprintf(f, "P6\n%d %d\n255\n", width, height);
+        std::fwrite(scratch.data(), 1, (size_t)width * height * 3, f);
+        std::fclose(f);
+    }
+
+    void run() {
+        while (true) {
+            int idx;
+            if (readyBuffers.tryDequeue(idx)) {
+                const uint32_t* px = idx == REPEAT_FRAME ? nullptr : buffers[idx].data();
+                if (px || written.load() > 0) {
+                    if (y4m) writeY4M(px);
+                    else writePPM(px, written.load());
+                    written++;
+                }
+                if (px) freeBuffers.enqueue(idx);
+                continue;
+            }
+            if (stopping.load()) break;
+
+            std::unique_lock<std::mutex> guard(wakeLock);
+            wake.wait_for(guard, std::chrono::milliseconds(10));
+        }
+    }
+
+public:
+    // Frame rate is fpsNum/fpsDen frames per second (only recorded for Y4M)
+    FrameCapture(const std::string& outPath, int w, int h, int rateNum, int rateDen, int poolSize = 8)
+        : width(w & ~1), height(h & ~1), fpsNum(rateNum), fpsDen(rateDen), path(outPath), y4m(false), stream(nullptr),
+          freeBuffers(poolSize), readyBuffers(poolSize + REPEAT_SLOTS), stopping(false), written(0), repeated(0),
+          dropped(0) {
+        y4m = path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+        if (y4m) {
+            stream = std::fopen(path.c_str(), "wb");
+            if (!stream) return;
+            std::fprintf(stream, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", width, height, fpsNum, fpsDen);
+        }
+
+        buffers.resize(poolSize, std::vector<uint32_t>((size_t)width * height));
+        for (int i = 0; i < poolSize; i++) freeBuffers.enqueue(i);
+        scratch.resize((size_t)width * height * 3);
+
+        writer = std::thread(&FrameCapture::run, this);
+    }
+
+    ~FrameCapture() {
+        finish();
+    }
+
+    // Writes every queued frame and stops the writer; later frames are dropped
+    void finish() {
+        stopping.store(true);
+        wake.notify_one();
+        if (writer.joinable()) writer.join();
+        if (stream) {
+            std::fclose(stream);
+            stream = nullptr;
+        }
+    }
+
+    bool isOpen() const {
+        return writer.joinable();
+    }
+
+    // Copies a frame of 32-bit xRGB pixels (`pitch` bytes per row) into a
+    // free buffer and queues it for writing. If no buffer is free, queues a
+    // repeat of the previous frame instead and returns false. Must be called
+    // from one thread.
+    bool submit(const void* pixels, int pitch) {
+        if (!isOpen()) {
+            dropped++;
+            return false;
+        }
+
+        int idx;
+        if (!freeBuffers.tryDequeue(idx)) {
+            // Leave room for every buffer so their enqueue below cannot fail
+            if (readyBuffers.size() + (int)buffers.size() < readyBuffers.capacity() &&
+                readyBuffers.tryEnqueue(REPEAT_FRAME)) {
+                repeated++;
+                wake.notify_one();
+            } else {
+                dropped++;
+            }
+            return false;
+        }
+
+        uint32_t* dst = buffers[idx].data();
+        for (int y = 0; y < height; y++) {
+            std::memcpy(dst + (size_t)y * width, static_cast<const char*>(pixels) + (size_t)y * pitch, width * 4);
+        }
+        readyBuffers.enqueue(idx);
+        wake.notify_one();
+        return true;
+    }
+
+    uint64_t framesWritten() const {
+        return written.load();
+    }
+
+    // Frames written as a copy of the previous one because the writer fell behind
+    uint64_t framesRepeated() const {
+        return repeated.load();
+    }
+
+    // Frames missing from the output entirely, which shortens its timeline
+    uint64_t framesDropped() const {
+        return dropped.load();
+    }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstdint>
+
+#include "queue.h"
+
+// Per-lane traffic history kept in fixed-size rings at three resolutions
+// (1 s, 1 min, 1 h). Finer buckets are consolidated into coarser ones as they
+// close, RRD-style, so memory stays constant however long the simulator runs.
+
+enum HistoryTier { TIER_SECOND = 0, TIER_MINUTE, TIER_HOUR };
+const int NUM_TIERS = 3;
+
+const int TIER_SECONDS[NUM_TIERS] = {1, 60, 3600};
+const int TIER_SLOTS[NUM_TIERS] = {300, 1440, 720}; // 5 min, 24 h, 30 days
+
+// Wait-time histogram bin upper bounds in seconds; the last bin is open-ended.
+// Histograms merge exactly, so percentiles survive consolidation.
+const int WAIT_BINS = 10;
+const int WAIT_BIN_LIMITS[WAIT_BINS] = {1, 2, 5, 10, 20, 30, 60, 120, 300, 0};
+
+// waitPercentile() results that are not a bin limit
+const int WAIT_NONE = -1;     // Nothing departed
+const int WAIT_OPEN_BIN = -2; // The percentile falls in the open-ended bin
+
+struct HistoryBucket {
+    int64_t start;       // Epoch seconds; 0 = unused
+    uint32_t arrivals;
+    uint32_t departures;
+    uint32_t queueSamples;
+    uint32_t queueMax;
+    uint64_t queueSum;
+    uint32_t waitHist[WAIT_BINS];
+
+    void reset(int64_t t) {
+        start = t;
+        arrivals = departures = queueSamples = queueMax = 0;
+        queueSum = 0;
+        for (int i = 0; i < WAIT_BINS; i++) waitHist[i] = 0;
+    }
+
+    void merge(const HistoryBucket& b) {
+        arrivals += b.arrivals;
+        departures += b.departures;
+        queueSamples += b.queueSamples;
+        queueSum += b.queueSum;
+        if (b.queueMax > queueMax) queueMax = b.queueMax;
+        for (int i = 0; i < WAIT_BINS; i++) waitHist[i] += b.waitHist[i];
+    }
+
+    double queueAverage() const {
+        return queueSamples ? (double)queueSum / queueSamples : 0.0;
+    }
+
+    // Upper bound in seconds of the bin holding the p-th wait percentile
+    // (0 < p <= 1), WAIT_NONE if nothing departed, or WAIT_OPEN_BIN if it lies
+    // beyond the last finite limit.
+    int waitPercentile(double p) const {
+        uint64_t total = 0;
+        for (int i = 0; i < WAIT_BINS; i++) total += waitHist[i];
+        if (total == 0) return WAIT_NONE;
+
+        uint64_t rank = (uint64_t)(p * total + 0.999999);
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < WAIT_BINS - 1; i++) {
+            seen += waitHist[i];
+            if (seen >= rank) return WAIT_BIN_LIMITS[i];
+        }
+        return WAIT_OPEN_BIN;
+    }
+};
+
+// Fixed-capacity ring of closed buckets, oldest overwritten first
+class HistoryRing {
+private:
+    HistoryBucket* slots;
+    int capacity;
+    int head;  // Next slot to write
+    int count;
+
+    HistoryRing(const HistoryRing&);
+    HistoryRing& operator=(const HistoryRing&);
+
+public:
+    HistoryRing() : slots(nullptr), capacity(0), head(0), count(0) {}
+
+    ~HistoryRing() {
+        delete[] slots;
+    }
+
+    void init(int cap) {
+        delete[] slots;
+        slots = new HistoryBucket[cap];
+        capacity = cap;
+        head = count = 0;
+    }
+
+    void push(const HistoryBucket& b) {
+        slots[head] = b;
+        head = (head + 1) % capacity;
+        if (count < capacity) count++;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    // i = 0 is the newest bucket
+    const HistoryBucket& at(int i) const {
+        return slots[(head - 1 - i + capacity) % capacity];
+    }
+};
+
+class LaneHistory {
+private:
+    HistoryRing rings[NUM_TIERS];
+    HistoryBucket open[NUM_TIERS]; // Buckets still accumulating, one per tier
+
+    // Closes the open bucket of `tier` and consolidates it upwards
+    void close(int tier, int64_t next) {
+        rings[tier].push(open[tier]);
+        if (tier + 1 < NUM_TIERS) {
+            open[tier + 1].merge(open[tier]);
+            if (next % TIER_SECONDS[tier + 1] == 0) close(tier + 1, next);
+        }
+        open[tier].reset(next);
+    }
+
+public:
+    LaneHistory() {
+        for (int t = 0; t < NUM_TIERS; t++) {
+            rings[t].init(TIER_SLOTS[t]);
+            open[t].reset(0);
+        }
+    }
+
+    // Closes every bucket that ended at or before `now`. Idle seconds produce
+    // empty buckets; after a gap longer than an hour (e.g. downtime) the open
+    // buckets are flushed once and realigned, leaving the gap visible in the
+    // bucket start times rather than filling it.
+    void advance(int64_t now) {
+        if (open[TIER_SECOND].start == 0) {
+            for (int t = 0; t < NUM_TIERS; t++) open[t].reset(now - now % TIER_SECONDS[t]);
+            return;
+        }
+
+        if (now - open[TIER_SECOND].start > TIER_SECONDS[NUM_TIERS - 1]) {
+            for (int t = 0; t < NUM_TIERS; t++) {
+                if (t + 1 < NUM_TIERS) open[t + 1].merge(open[t]);
+                rings[t].push(open[t]);
+                open[t].reset(now - now % TIER_SECONDS[t]);
+            }
+            return;
+        }
+
+        while (open[TIER_SECOND].start + 1 <= now) {
+            close(TIER_SECOND, open[TIER_SECOND].start + 1);
+        }
+    }
+
+    void recordArrival(int64_t now) {
+        advance(now);
+        open[TIER_SECOND].arrivals++;
+    }
+
+    void recordDeparture(int64_t now, int64_t waitSeconds) {
+        advance(now);
+        open[TIER_SECOND].departures++;
+
+        int bin = WAIT_BINS - 1;
+        for (int i = 0; i < WAIT_BINS - 1; i++) {
+            if (waitSeconds < WAIT_BIN_LIMITS[i]) { bin = i; break; }
+        }
+        open[TIER_SECOND].waitHist[bin]++;
+    }
+
+    void sampleQueue(int64_t now, uint32_t length) {
+        advance(now);
+        HistoryBucket& b = open[TIER_SECOND];
+        b.queueSamples++;
+        b.queueSum += length;
+        if (length > b.queueMax) b.queueMax = length;
+    }
+
+    const HistoryRing& ring(HistoryTier tier) const {
+        return rings[tier];
+    }
+};
+
+// History for every lane plus the query API used by the HUD and exporters
+class TrafficHistory {
+private:
+    LaneHistory lanes[NUM_LANES];
+
+public:
+    void recordArrival(int lane, int64_t now) {
+        lanes[lane].recordArrival(now);
+    }
+
+    void recordDeparture(int lane, int64_t now, int64_t waitSeconds) {
+        lanes[lane].recordDeparture(now, waitSeconds);
+    }
+
+    // Called periodically with the current queue lengths
+    void sample(int64_t now, const uint32_t depths[NUM_LANES]) {
+        for (int i = 0; i < NUM_LANES; i++) lanes[i].sampleQueue(now, depths[i]);
+    }
+
+    // Copies up to maxPoints closed buckets, newest first. Returns the count.
+    int query(int lane, HistoryTier tier, HistoryBucket* out, int maxPoints) const {
+        const HistoryRing& r = lanes[lane].ring(tier);
+        int n = r.size() < maxPoints ? r.size() : maxPoints;
+        for (int i = 0; i < n; i++) out[i] = r.at(i);
+        return n;
+    }
+
+    // Merges the newest `points` closed buckets of a tier into one. Pass
+    // lane = -1 to merge across every lane.
+    HistoryBucket summarize(int lane, HistoryTier tier, int points) const {
+        HistoryBucket total;
+        total.reset(0);
+        for (int l = 0; l < NUM_LANES; l++) {
+            if (lane >= 0 && l != lane) continue;
+            const HistoryRing& r = lanes[l].ring(tier);
+            int n = r.size() < points ? r.size() : points;
+            for (int i = 0; i < n; i++) {
+                total.merge(r.at(i));
+                if (total.start == 0 || r.at(i).start < total.start) total.start = r.at(i).start;
+            }
+        }
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef LANE_PARSER_H
+#define LANE_PARSER_H
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Batch parser for lane files ("id,epoch,lane[,class]" per line). The whole file is
+// read into one buffer and fields are handed out as pointer/length pairs, so
+// no per-line strings or streams are created.
+
+// Returns the first ',' or '\n' in [p, end), or end if there is none
+inline const char* findDelim(const char* p, const char* end) {
+#if defined(__AVX2__)
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, comma), _mm256_cmpeq_epi8(chunk, nl)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, nl)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != ',' && *p != '\n') p++;
+    return p;
+}
+
+// Parses a signed decimal field into 64 bits. Returns false on an empty or
+// non-numeric field, or one whose magnitude does not fit in int64_t.
+inline bool parseInt64(const char* p, const char* end, int64_t& out) {
+    bool neg = false;
+    if (p < end && *p == '-') { neg = true; p++; }
+    if (p == end) return false;
+
+    int64_t value = 0;
+    for (; p < end; p++) {
+        unsigned d = (unsigned)(*p - '0');
+        if (d > 9) return false;
+        if (value > (INT64_MAX - (int64_t)d) / 10) return false;
+        value = value * 10 + d;
+    }
+    out = neg ? -value : value;
+    return true;
+}
+
+// Reads the whole of `path` into `buf`. Returns false if it cannot be opened.
+inline bool readLaneFile(const char* path, std::vector<char>& buf) {
+    FILE* f = std::fopen(path, "rb");
+    if (!f) return false;
+
+    buf.clear();
+    char chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        buf.insert(buf.end(), chunk, chunk + n);
+    }
+    std::fclose(f);
+    return true;
+}
+
+// End of the field [begin, fieldEnd) without the '\r' of a CRLF line ending
+inline const char* trimCR(const char* begin, const char* fieldEnd, const char* end) {
+    bool lastField = fieldEnd == end || *fieldEnd == '\n';
+    return (lastField && fieldEnd > begin && fieldEnd[-1] == '\r') ? fieldEnd - 1 : fieldEnd;
+}
+
+// Calls onRecord(id, idLen, epoch, lane, laneLen, cls, clsLen) for every
+// well-formed line in [data, data+len). Lines may end in "\n" or "\r\n". A
+// missing class field is passed as empty. Blank and malformed lines are skipped.
+template <typename F>
+void parseLaneRecords(const char* data, size_t len, F onRecord) {
+    const char* p = data;
+    const char* end = data + len;
+
+    while (p < end) {
+        const char* idEnd = findDelim(p, end);
+        if (idEnd == end) break;
+        if (*idEnd == '\n') { p = idEnd + 1; continue; }
+
+        const char* tBegin = idEnd + 1;
+        const char* tEnd = findDelim(tBegin, end);
+
+        const char* lBegin = tEnd;
+        const char* lEnd = tEnd;
+        if (tEnd < end && *tEnd == ',') {
+            lBegin = tEnd + 1;
+            lEnd = findDelim(lBegin, end);
+        }
+
+        const char* cBegin = lEnd;
+        const char* cEnd = lEnd;
+        if (lEnd < end && *lEnd == ',') {
+            cBegin = lEnd + 1;
+            cEnd = findDelim(cBegin, end);
+        }
+
+        // Skip any trailing fields up to the end of the line
+        const char* lineEnd = cEnd;
+        while (lineEnd < end && *lineEnd != '\n') lineEnd = findDelim(lineEnd + 1, end);
+
+        const char* tStop = trimCR(tBegin, tEnd, end);
+        const char* lStop = trimCR(lBegin, lEnd, end);
+        const char* cStop = trimCR(cBegin, cEnd, end);
+
+        int64_t epoch;
+        if (idEnd > p && parseInt64(tBegin, tStop, epoch)) {
+            onRecord(p, (size_t)(idEnd - p), epoch, lBegin, (size_t)(lStop - lBegin),
+                     cBegin, (size_t)(cStop - cBegin));
+        }
+        p = (lineEnd < end) ? lineEnd + 1 : end;
+    }
+}
+
+#endif
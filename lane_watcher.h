@@ -0,0 +1,88 @@
+#ifndef LANE_WATCHER_H
+#define LANE_WATCHER_H
+
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Reports which lane files changed since the last call, so the simulator only
+// re-reads lanes that received arrivals. Uses inotify on the working
+// directory; where that is unavailable every lane is reported on every call.
+class LaneWatcher {
+private:
+    const char** files;
+    int numFiles;
+    int fd;
+    unsigned pending;
+
+    unsigned allLanes() const {
+        return (1u << numFiles) - 1;
+    }
+
+#ifdef __linux__
+    // Drains queued events into the pending mask
+    void drain() {
+        alignas(struct inotify_event) char buf[4096];
+        ssize_t len;
+        while ((len = read(fd, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len; ) {
+                struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+                if (ev->mask & IN_Q_OVERFLOW) pending |= allLanes();
+                if (ev->len > 0) {
+                    for (int i = 0; i < numFiles; i++) {
+                        if (std::strcmp(ev->name, files[i]) == 0) pending |= 1u << i;
+                    }
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+    }
+#endif
+
+public:
+    LaneWatcher(const char** laneFiles, int n)
+        : files(laneFiles), numFiles(n), fd(-1), pending(0) {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, ".", IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO) < 0) {
+            close(fd);
+            fd = -1;
+        }
+#endif
+        // Anything written before the watch started must still be read
+        pending = allLanes();
+    }
+
+    ~LaneWatcher() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    bool isActive() const {
+        return fd >= 0;
+    }
+
+    // Waits up to timeoutMs for a lane file to change and returns the mask of
+    // changed lanes (bit i = files[i]), clearing it. Returns 0 on timeout.
+    // Without inotify this returns every lane immediately.
+    unsigned wait(int timeoutMs) {
+        if (fd < 0) return allLanes();
+#ifdef __linux__
+        if (pending == 0 && timeoutMs > 0) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            poll(&pfd, 1, timeoutMs);
+        }
+        drain();
+#endif
+        unsigned changed = pending;
+        pending = 0;
+        return changed;
+    }
+};
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+// Counters published by the simulator. Lives in a shared-memory page guarded
+// by a seqlock: `sequence` is odd while a write is in progress, so readers
+// retry until they see the same even value before and after copying.
+struct MetricsPage {
+    std::atomic<uint32_t> sequence;
+    uint32_t version;
+    uint64_t updatedMs;
+    int32_t greenLane;       // -1 if none
+    int32_t priorityMode;
+    uint64_t vehiclesPassed;
+    uint32_t queueDepth[NUM_LANES];
+    uint64_t arrivals[NUM_LANES];
+    uint64_t dispatches[NUM_LANES];
+    double arrivalRate[NUM_LANES];  // per second over the last window
+    double dispatchRate[NUM_LANES];
+    double waitP95[NUM_LANES];      // seconds over the last minute, NaN if none departed, +Inf past the last bin
+};
+
+// Copies a consistent view of a page another thread or process is writing
+inline void readMetricsPage(const MetricsPage* page, MetricsPage& out) {
+    uint32_t before, after;
+    do {
+        before = page->sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        std::memcpy(reinterpret_cast<char*>(&out) + sizeof(out.sequence),
+                    reinterpret_cast<const char*>(page) + sizeof(page->sequence),
+                    sizeof(MetricsPage) - sizeof(page->sequence));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = page->sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+// Renders a page in Prometheus text exposition format
+inline std::string formatMetrics(const MetricsPage& m) {
+    std::string out;
+    char line[160];
+
+    auto perLane = [&](const char* name, const char* type, const char* help, double (*value)(const MetricsPage&, int)) {
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+        out += line;
+        for (int i = 0; i < NUM_LANES; i++) {
+            double v = value(m, i);
+            if (std::isnan(v)) std::snprintf(line, sizeof(line), "%s{lane=\"%s\"} NaN\n", name, LANE_LABELS[i]);
+            else if (std::isinf(v)) std::snprintf(line, sizeof(line), "%s{lane=\"%s\"} %sInf\n", name, LANE_LABELS[i], v > 0 ? "+" : "-");
+            else std::snprintf(line, sizeof(line), "%s{lane=\"%s\"} %.6g\n", name, LANE_LABELS[i], v);
+            out += line;
+        }
+    };
+
+    perLane("tlq_queue_depth", "gauge", "Vehicles queued per lane",
+            [](const MetricsPage& p, int i) { return (double)p.queueDepth[i]; });
+    perLane("tlq_green", "gauge", "1 if the lane currently has the green light",
+            [](const MetricsPage& p, int i) { return p.greenLane == i ? 1.0 : 0.0; });
+    perLane("tlq_arrivals_total", "counter", "Vehicles ingested per lane",
+            [](const MetricsPage& p, int i) { return (double)p.arrivals[i]; });
+    perLane("tlq_dispatches_total", "counter", "Vehicles released through the junction per lane",
+            [](const MetricsPage& p, int i) { return (double)p.dispatches[i]; });
+    perLane("tlq_arrival_rate", "gauge", "Arrivals per second per lane",
+            [](const MetricsPage& p, int i) { return p.arrivalRate[i]; });
+    perLane("tlq_dispatch_rate", "gauge", "Dispatches per second per lane",
+            [](const MetricsPage& p, int i) { return p.dispatchRate[i]; });
+    perLane("tlq_wait_p95_seconds", "gauge", "95th percentile wait over the last minute (bin upper bound, +Inf beyond 300s)",
+            [](const MetricsPage& p, int i) { return p.waitP95[i]; });
+
+    std::snprintf(line, sizeof(line),
+                  "# HELP tlq_priority_mode 1 while the AL2 priority override is active\n"
+                  "# TYPE tlq_priority_mode gauge\ntlq_priority_mode %d\n", m.priorityMode);
+    out += line;
+    std::snprintf(line, sizeof(line),
+                  "# HELP tlq_vehicles_passed_total Vehicles released through the junction\n"
+                  "# TYPE tlq_vehicles_passed_total counter\ntlq_vehicles_passed_total %llu\n",
+                  (unsigned long long)m.vehiclesPassed);
+    out += line;
+    return out;
+}
+
+// Owns the shared-memory page and the Unix-socket endpoint. The simulation
+// thread only writes the page; a background thread answers scrapes from a
+// seqlock copy, so collectors never block the simulation.
+class MetricsPublisher {
+private:
+    static const uint32_t VERSION = 1;
+    static const uint64_t RATE_WINDOW_MS = 1000;
+
+    std::string shmName;
+    std::string socketPath;
+    MetricsPage* page;
+    int listenFd;
+    std::atomic<bool> stopping;
+    std::thread server;
+
+    // Simulation-thread state
+    uint64_t arrivals[NUM_LANES];
+    uint64_t dispatches[NUM_LANES];
+    uint64_t windowArrivals[NUM_LANES];
+    uint64_t windowDispatches[NUM_LANES];
+    double arrivalRate[NUM_LANES];
+    double dispatchRate[NUM_LANES];
+    uint64_t windowStartMs;
+
+    void serve() {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            struct pollfd pfd = {listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) continue;
+
+            int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+
+            MetricsPage snapshot;
+            readMetricsPage(page, snapshot);
+            std::string body = formatMetrics(snapshot);
+
+            const char* p = body.data();
+            size_t left = body.size();
+            while (left > 0) {
+                ssize_t n = send(client, p, left, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                p += n;
+                left -= n;
+            }
+            close(client);
+        }
+    }
+
+public:
+    MetricsPublisher(const char* shm, const char* sockPath)
+        : shmName(shm), socketPath(sockPath), page(nullptr), listenFd(-1), stopping(false), windowStartMs(0) {
+        for (int i = 0; i < NUM_LANES; i++) {
+            arrivals[i] = dispatches[i] = windowArrivals[i] = windowDispatches[i] = 0;
+            arrivalRate[i] = dispatchRate[i] = 0;
+        }
+
+        int fd = shm_open(shm, O_RDWR | O_CREAT, 0644);
+        if (fd >= 0 && ftruncate(fd, sizeof(MetricsPage)) == 0) {
+            void* m = mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (m != MAP_FAILED) {
+                std::memset(m, 0, sizeof(MetricsPage));
+                page = new (m) MetricsPage;
+                page->sequence.store(0, std::memory_order_relaxed);
+                page->version = VERSION;
+                page->greenLane = -1;
+            }
+        }
+        if (fd >= 0) close(fd);
+        if (!page) {
+            std::cerr << "Metrics: cannot map shared memory " << shm << std::endl;
+            return;
+        }
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, sockPath, sizeof(addr.sun_path) - 1);
+        unlink(sockPath);
+
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFd, 8) != 0) {
+            std::cerr << "Metrics: cannot listen on " << sockPath << std::endl;
+            if (listenFd >= 0) close(listenFd);
+            listenFd = -1;
+            return;
+        }
+        server = std::thread(&MetricsPublisher::serve, this);
+    }
+
+    ~MetricsPublisher() {
+        stopping.store(true);
+        if (server.joinable()) server.join();
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(socketPath.c_str());
+        }
+        if (page) {
+            munmap(page, sizeof(MetricsPage));
+            shm_unlink(shmName.c_str());
+        }
+    }
+
+    void recordArrival(int lane) {
+        arrivals[lane]++;
+    }
+
+    void recordDispatch(int lane) {
+        dispatches[lane]++;
+    }
+
+    // Publishes the current state; called once per frame
+    void publish(const uint32_t depths[NUM_LANES], const double waitP95[NUM_LANES], int greenLane, bool priority,
+                 uint64_t passed, uint64_t nowMs) {
+        if (!page) return;
+
+        uint64_t elapsed = nowMs - windowStartMs;
+        if (elapsed >= RATE_WINDOW_MS) {
+            for (int i = 0; i < NUM_LANES; i++) {
+                arrivalRate[i] = (arrivals[i] - windowArrivals[i]) * 1000.0 / elapsed;
+                dispatchRate[i] = (dispatches[i] - windowDispatches[i]) * 1000.0 / elapsed;
+                windowArrivals[i] = arrivals[i];
+                windowDispatches[i] = dispatches[i];
+            }
+            windowStartMs = nowMs;
+        }
+
+        uint32_t seq = page->sequence.load(std::memory_order_relaxed);
+        page->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        page->updatedMs = nowMs;
+        page->greenLane = greenLane;
+        page->priorityMode = priority;
+        page->vehiclesPassed = passed;
+        for (int i = 0; i < NUM_LANES; i++) {
+            page->queueDepth[i] = depths[i];
+            page->arrivals[i] = arrivals[i];
+            page->dispatches[i] = dispatches[i];
+            page->arrivalRate[i] = arrivalRate[i];
+            page->dispatchRate[i] = dispatchRate[i];
+            page->waitP95[i] = waitP95[i];
+        }
+
+        page->sequence.store(seq + 2, std::memory_order_release);
+    }
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <cstdlib>
+
+#include "queue.h"
+#include "lane_parser.h"
+#include "signal_plan.h"
+
+// Offline signal-plan optimizer. Replays a recorded arrival log (lane*.txt
+// format) through the controller's queue model and searches for the phase
+// order and green splits with the lowest total or p95 wait, then writes a
+// plan file for `sim --plan`.
+
+const int64_t DRAIN_HORIZON_MS = 3600 * 1000; // Vehicles still queued this long after the last arrival count as waiting until then
+const int MIN_GREEN_MS = DISPATCH_INTERVAL_MS;
+const int MAX_GREEN_MS = 10000;
+const int GREEN_GRID[] = {1000, 1500, 2000, 3000, 4000, 6000, 8000};
+const int GRID_SIZE = sizeof(GREEN_GRID) / sizeof(GREEN_GRID[0]);
+
+enum Objective { OBJECTIVE_TOTAL, OBJECTIVE_P95 };
+
+// Arrival times in ms since the first arrival, sorted, one list per lane
+struct ArrivalLog {
+    std::vector<int64_t> lanes[NUM_LANES];
+    int64_t lastMs;
+    size_t count;
+};
+
+struct Evaluation {
+    double totalWaitS;
+    double p95WaitS;
+    double objective;
+};
+
+bool loadArrivalLog(const std::vector<std::string>& files, ArrivalLog& log) {
+    std::vector<int64_t> epochs[NUM_LANES];
+    std::vector<char> buf;
+    int64_t first = std::numeric_limits<int64_t>::max();
+
+    for (size_t f = 0; f < files.size(); f++) {
+        if (!readLaneFile(files[f].c_str(), buf)) {
+            std::cerr << "Error: Could not open file " << files[f] << std::endl;
+            return false;
+        }
+        parseLaneRecords(buf.data(), buf.size(),
+            [&](const char*, size_t, int64_t epoch, const char* lane, size_t laneLen, const char*, size_t) {
+                int l = laneFromLabel(lane, laneLen);
+                if (l < 0) return;
+                epochs[l].push_back(epoch);
+                if (epoch < first) first = epoch;
+            });
+    }
+
+    log.lastMs = 0;
+    log.count = 0;
+    for (int l = 0; l < NUM_LANES; l++) {
+        log.lanes[l].clear();
+        for (size_t i = 0; i < epochs[l].size(); i++) log.lanes[l].push_back((epochs[l][i] - first) * 1000);
+        std::sort(log.lanes[l].begin(), log.lanes[l].end());
+        if (!log.lanes[l].empty()) log.lastMs = std::max(log.lastMs, log.lanes[l].back());
+        log.count += log.lanes[l].size();
+    }
+    return log.count > 0;
+}
+
+// Replays the log through the controller model: FIFO lanes, one dispatch per
+// DISPATCH_INTERVAL_MS on the green lane, the AL2 override between
+// PRIORITY_START and PRIORITY_END, and the plan's phases otherwise.
+// When minimising total wait the run is abandoned as soon as the wait so far
+// exceeds `bound` (branch and bound); returns false in that case.
+bool evaluatePlan(const SignalPlan& plan, const ArrivalLog& log, Objective objective, double bound,
+                  std::vector<int64_t>& waits, Evaluation& out) {
+    size_t arrived[NUM_LANES] = {0, 0, 0, 0}; // Queue of lane l is [served[l], arrived[l])
+    size_t served[NUM_LANES] = {0, 0, 0, 0};
+    size_t remaining = log.count;
+    int64_t boundMs = bound >= std::numeric_limits<double>::max() / 2 ? std::numeric_limits<int64_t>::max()
+                                                                       : (int64_t)(bound * 1000);
+    int64_t totalMs = 0;
+    int64_t endMs = log.lastMs + DRAIN_HORIZON_MS;
+
+    bool priorityMode = false;
+    size_t phase = 0;
+    int64_t phaseStart = 0;
+    waits.clear();
+
+    for (int64_t t = 0; t <= endMs && remaining > 0; t += DISPATCH_INTERVAL_MS) {
+        for (int l = 0; l < NUM_LANES; l++) {
+            while (arrived[l] < log.lanes[l].size() && log.lanes[l][arrived[l]] <= t) arrived[l]++;
+        }
+
+        int countA = (int)(arrived[LANE_A] - served[LANE_A]);
+        if (!priorityMode && countA >= PRIORITY_START) {
+            priorityMode = true;
+        } else if (priorityMode && countA < PRIORITY_END) {
+            priorityMode = false;
+            phaseStart = t;
+        }
+
+        if (!priorityMode && t - phaseStart >= plan.phases[phase].greenMs) {
+            phase = (phase + 1) % plan.phases.size();
+            phaseStart = t;
+        }
+
+        int active = priorityMode ? (int)LANE_A : plan.phases[phase].lane;
+        if (served[active] < arrived[active]) {
+            int64_t wait = t - log.lanes[active][served[active]++];
+            totalMs += wait;
+            waits.push_back(wait);
+            remaining--;
+            if (objective == OBJECTIVE_TOTAL && totalMs > boundMs) return false;
+        }
+    }
+
+    // Anything left waited until the horizon
+    for (int l = 0; l < NUM_LANES; l++) {
+        for (size_t i = served[l]; i < log.lanes[l].size(); i++) {
+            int64_t wait = endMs - log.lanes[l][i];
+            totalMs += wait;
+            waits.push_back(wait);
+        }
+    }
+
+    size_t k = (size_t)(waits.size() * 0.95);
+    if (k >= waits.size()) k = waits.size() - 1;
+    std::nth_element(waits.begin(), waits.begin() + k, waits.end());
+
+    out.totalWaitS = totalMs / 1000.0;
+    out.p95WaitS = waits[k] / 1000.0;
+    out.objective = objective == OBJECTIVE_TOTAL ? out.totalWaitS : out.p95WaitS;
+    return objective != OBJECTIVE_TOTAL || totalMs <= boundMs;
+}
+
+// Candidate `index` of the coarse search: a phase order (one of the 24
+// permutations of the lanes) and a grid green time for each phase
+SignalPlan candidatePlan(long index) {
+    int order[NUM_LANES] = {LANE_A, LANE_B, LANE_C, LANE_D};
+    long perm = index;
+    for (int i = 0; i < NUM_LANES; i++) perm /= GRID_SIZE;
+    for (long p = 0; p < perm; p++) std::next_permutation(order, order + NUM_LANES);
+
+    SignalPlan plan;
+    long g = index;
+    for (int i = 0; i < NUM_LANES; i++) {
+        SignalPhase phase = {order[i], GREEN_GRID[g % GRID_SIZE]};
+        plan.phases.push_back(phase);
+        g /= GRID_SIZE;
+    }
+    return plan;
+}
+
+// Evaluates every coarse candidate on `threads` workers sharing one bound
+SignalPlan searchPlans(const ArrivalLog& log, Objective objective, int threads, Evaluation& best) {
+    long gridPlans = 1;
+    for (int i = 0; i < NUM_LANES; i++) gridPlans *= GRID_SIZE;
+    const long candidates = gridPlans * 24;
+
+    std::atomic<long> nextIndex(0);
+    std::mutex bestLock;
+    double bestObjective = std::numeric_limits<double>::max();
+    SignalPlan bestPlan = defaultSignalPlan();
+
+    auto worker = [&]() {
+        std::vector<int64_t> waits;
+        Evaluation e;
+        long i;
+        while ((i = nextIndex.fetch_add(1)) < candidates) {
+            SignalPlan plan = candidatePlan(i);
+            double bound;
+            {
+                std::lock_guard<std::mutex> guard(bestLock);
+                bound = bestObjective;
+            }
+            if (!evaluatePlan(plan, log, objective, bound, waits, e)) continue;
+
+            std::lock_guard<std::mutex> guard(bestLock);
+            if (e.objective < bestObjective) {
+                bestObjective = e.objective;
+                bestPlan = plan;
+                best = e;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) pool.push_back(std::thread(worker));
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+    return bestPlan;
+}
+
+// Coordinate descent on the green times in DISPATCH_INTERVAL_MS steps
+void refinePlan(SignalPlan& plan, const ArrivalLog& log, Objective objective, Evaluation& best) {
+    std::vector<int64_t> waits;
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (size_t p = 0; p < plan.phases.size(); p++) {
+            for (int step = -DISPATCH_INTERVAL_MS; step <= DISPATCH_INTERVAL_MS; step += 2 * DISPATCH_INTERVAL_MS) {
+                SignalPlan trial = plan;
+                trial.phases[p].greenMs += step;
+                if (trial.phases[p].greenMs < MIN_GREEN_MS || trial.phases[p].greenMs > MAX_GREEN_MS) continue;
+
+                Evaluation e;
+                if (evaluatePlan(trial, log, objective, best.objective, waits, e) && e.objective < best.objective) {
+                    plan = trial;
+                    best = e;
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Objective objective = OBJECTIVE_TOTAL;
+    std::string outPath = "plan.txt";
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--objective" && i + 1 < argc) {
+            std::string o = argv[++i];
+            if (o == "p95") objective = OBJECTIVE_P95;
+            else if (o != "total") { std::cerr << "Unknown objective " << o << std::endl; return 1; }
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--objective total|p95] [--out plan.txt] [--threads N] log.txt..." << std::endl;
+        return 1;
+    }
+
+    ArrivalLog log;
+    if (!loadArrivalLog(files, log)) {
+        std::cerr << "No arrivals found" << std::endl;
+        return 1;
+    }
+    std::cout << "Loaded " << log.count << " arrivals over " << log.lastMs / 1000 << "s" << std::endl;
+
+    std::vector<int64_t> waits;
+    Evaluation baseline;
+    evaluatePlan(defaultSignalPlan(), log, objective, std::numeric_limits<double>::max(), waits, baseline);
+
+    Evaluation best;
+    SignalPlan plan = searchPlans(log, objective, threads, best);
+    refinePlan(plan, log, objective, best);
+
+    std::cout << "Round robin: total wait " << baseline.totalWaitS << "s, p95 " << baseline.p95WaitS << "s" << std::endl;
+    std::cout << "Optimized:   total wait " << best.totalWaitS << "s, p95 " << best.p95WaitS << "s" << std::endl;
+
+    std::string comment = std::string("Optimized for ") + (objective == OBJECTIVE_TOTAL ? "total" : "p95") +
+                          " wait over " + std::to_string(log.count) + " arrivals";
+    if (!saveSignalPlan(outPath.c_str(), plan, comment)) {
+        std::cerr << "Error: Could not write " << outPath << std::endl;
+        return 1;
+    }
+    std::cout << "Plan written to " << outPath << std::endl;
+    return 0;
+}
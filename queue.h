@@ -3,20 +3,87 @@
 
 #include <iostream>
 #include <string>
-#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <atomic>
 
-// Vehicle class to represent a vehicle
+const int VEHICLE_ID_LEN = 8;
+const int NUM_LANES = 4;
+
+// Lane index, also the lane file / approach index
+enum LaneIndex : uint8_t { LANE_A = 0, LANE_B, LANE_C, LANE_D };
+
+constexpr const char* LANE_LABELS[NUM_LANES] = {"AL2", "BL2", "CL2", "DL2"};
+
+// Vehicle class, in increasing order of priority
+enum VehicleClass : uint8_t { CLASS_NORMAL = 0, CLASS_TRANSIT, CLASS_EMERGENCY };
+const int NUM_CLASSES = 3;
+
+constexpr const char* CLASS_LABELS[NUM_CLASSES] = {"normal", "transit", "emergency"};
+
+// Lane priorities used by the controller, highest wins
+const int PRIORITY_NORMAL = 0;
+const int PRIORITY_CYCLE = 50;
+const int PRIORITY_CONGESTED = 100;
+const int PRIORITY_TRANSIT = 150;
+const int PRIORITY_EMERGENCY = 200;
+
+// Maps a class label to its VehicleClass; unknown or empty labels are normal
+inline uint8_t classFromLabel(const char* s, size_t len) {
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        if (std::strlen(CLASS_LABELS[c]) == len && std::memcmp(CLASS_LABELS[c], s, len) == 0) return (uint8_t)c;
+    }
+    return CLASS_NORMAL;
+}
+
+// Packs up to VEHICLE_ID_LEN characters into a uint64_t, first character in
+// the most significant byte so packed IDs order like their strings
+inline uint64_t packVehicleID(const char* s, size_t len) {
+    uint64_t packed = 0;
+    for (int i = 0; i < VEHICLE_ID_LEN; i++) {
+        packed <<= 8;
+        if ((size_t)i < len) packed |= (uint8_t)s[i];
+    }
+    return packed;
+}
+
+inline std::string unpackVehicleID(uint64_t packed) {
+    std::string id;
+    for (int shift = (VEHICLE_ID_LEN - 1) * 8; shift >= 0; shift -= 8) {
+        char c = (char)((packed >> shift) & 0xFF);
+        if (c) id += c;
+    }
+    return id;
+}
+
+// Vehicle class to represent a vehicle. Fixed-size and trivially copyable;
+// strings are only produced at the edges via idString()/laneLabel().
 class Vehicle {
 public:
-    std::string id;
-    time_t arrivalTime;
-    std::string lane;
+    uint64_t id;
+    int64_t arrivalTime;
+    uint8_t lane;
+    uint8_t vclass;
     
-    Vehicle() : id(""), arrivalTime(0), lane("") {}
-    Vehicle(std::string vid, time_t aTime, std::string vLane) 
-        : id(vid), arrivalTime(aTime), lane(vLane) {}
+    Vehicle() : id(0), arrivalTime(0), lane(LANE_A), vclass(CLASS_NORMAL) {}
+    Vehicle(uint64_t vid, int64_t aTime, uint8_t vLane, uint8_t vClass = CLASS_NORMAL) 
+        : id(vid), arrivalTime(aTime), lane(vLane), vclass(vClass) {}
+
+    std::string idString() const { return unpackVehicleID(id); }
+    const char* laneLabel() const { return LANE_LABELS[lane]; }
+    const char* classLabel() const { return CLASS_LABELS[vclass]; }
 };
 
+static_assert(std::is_trivially_copyable<Vehicle>::value, "Vehicle must stay memcpy-able");
+static_assert(sizeof(Vehicle) <= 24, "Vehicle must stay compact");
+
+inline std::ostream& operator<<(std::ostream& os, const Vehicle& v) {
+    return os << v.idString();
+}
+
 // Node for Queue implementation
 template <typename T>
 class QNode {
@@ -89,28 +156,259 @@ public:
         return count;
     }
     
+    // Visits every element front to back without removing it
+    template <typename F>
+    void forEach(F visit) const {
+        for (QNode<T>* temp = front; temp != nullptr; temp = temp->next) {
+            visit(temp->data);
+        }
+    }
+    
     void display() {
         QNode<T>* temp = front;
         while (temp != nullptr) {
-            std::cout << temp->data.id << " ";
+            std::cout << temp->data << " ";
             temp = temp->next;
         }
         std::cout << std::endl;
     }
 };
 
+// Bounded lock-free multi-producer/multi-consumer variant of Queue (Vyukov
+// ring). Each cell carries a sequence number that tells producers and
+// consumers whose turn it is, so no locks or node allocation are needed and
+// several threads may enqueue and dequeue concurrently.
+template <typename T>
+class ConcurrentQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+    
+    static const size_t CACHE_LINE = 64;
+    
+    Cell* cells;
+    size_t mask;
+    // Padding keeps the two positions on separate cache lines, away from the
+    // read-only fields above and whatever follows the queue, without
+    // over-aligning the class (alignas(64) members are not honoured by plain
+    // new before C++17, e.g. for classes that embed a queue)
+    char pad0[CACHE_LINE - sizeof(Cell*) - sizeof(size_t)];
+    std::atomic<size_t> enqueuePos;
+    char pad1[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeuePos;
+    char pad2[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    
+    ConcurrentQueue(const ConcurrentQueue&);
+    ConcurrentQueue& operator=(const ConcurrentQueue&);
+    
+public:
+    // Capacity is rounded up to a power of two
+    ConcurrentQueue(size_t capacity = 1024) : enqueuePos(0), dequeuePos(0) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask = cap - 1;
+        cells = new Cell[cap];
+        for (size_t i = 0; i < cap; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    ~ConcurrentQueue() {
+        delete[] cells;
+    }
+    
+    // Returns false if the queue is full
+    bool tryEnqueue(const T& data) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = data;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Returns false if the queue is empty
+    bool tryDequeue(T& out) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        out = cell->data;
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+    
+    void enqueue(T data) {
+        if (!tryEnqueue(data)) {
+            throw std::runtime_error("Queue is full");
+        }
+    }
+    
+    T dequeue() {
+        T data;
+        if (!tryDequeue(data)) {
+            throw std::runtime_error("Queue is empty");
+        }
+        return data;
+    }
+    
+    // Snapshot only; may be stale by the time the caller acts on it
+    bool isEmpty() const {
+        return size() == 0;
+    }
+    
+    int size() const {
+        size_t tail = dequeuePos.load(std::memory_order_acquire);
+        size_t head = enqueuePos.load(std::memory_order_acquire);
+        return head > tail ? (int)(head - tail) : 0;
+    }
+    
+    int capacity() const {
+        return (int)(mask + 1);
+    }
+};
+
+// Lane queue split into one FIFO bucket per VehicleClass. A bitmask of
+// non-empty buckets gives the highest waiting class in O(1).
+class ClassQueue {
+private:
+    Queue<Vehicle> buckets[NUM_CLASSES];
+    unsigned occupied;
+    int count;
+    
+public:
+    ClassQueue() : occupied(0), count(0) {}
+    
+    void enqueue(Vehicle v) {
+        buckets[v.vclass].enqueue(v);
+        occupied |= 1u << v.vclass;
+        count++;
+    }
+    
+    // Removes the oldest vehicle of the given class
+    Vehicle dequeue(int vclass) {
+        Vehicle v = buckets[vclass].dequeue();
+        if (buckets[vclass].isEmpty()) occupied &= ~(1u << vclass);
+        count--;
+        return v;
+    }
+    
+    // Removes the oldest vehicle of the highest waiting class
+    Vehicle dequeue() {
+        if (isEmpty()) {
+            throw std::runtime_error("Queue is empty");
+        }
+        return dequeue(topClass());
+    }
+    
+    // Oldest vehicle of the given class, without removing it
+    Vehicle peek(int vclass) {
+        return buckets[vclass].peek();
+    }
+    
+    // Highest class with a waiting vehicle, or -1 if empty
+    int topClass() const {
+        return occupied ? 31 - __builtin_clz(occupied) : -1;
+    }
+    
+    bool hasClass(int vclass) const {
+        return (occupied >> vclass) & 1u;
+    }
+    
+    bool isEmpty() const {
+        return count == 0;
+    }
+    
+    int size() const {
+        return count;
+    }
+    
+    // Visits every vehicle, lowest class first, FIFO within a class
+    template <typename F>
+    void forEach(F visit) const {
+        for (int c = 0; c < NUM_CLASSES; c++) buckets[c].forEach(visit);
+    }
+};
+
+// Tracks which lanes hold a vehicle of each class, so the controller finds
+// the highest-class waiting vehicle across the junction in O(1)
+class ClassIndex {
+private:
+    unsigned laneMask[NUM_CLASSES];
+    
+public:
+    ClassIndex() {
+        for (int c = 0; c < NUM_CLASSES; c++) laneMask[c] = 0;
+    }
+    
+    // Refreshes the bits for one lane after its queue changed
+    void update(int lane, const ClassQueue& q) {
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            if (q.hasClass(c)) laneMask[c] |= 1u << lane;
+            else laneMask[c] &= ~(1u << lane);
+        }
+    }
+    
+    // Highest class waiting on any lane, or -1 if every lane is empty
+    int highestClass() const {
+        for (int c = NUM_CLASSES - 1; c >= 0; c--) {
+            if (laneMask[c]) return c;
+        }
+        return -1;
+    }
+    
+    // Lane whose oldest vehicle of the class arrived first, or -1 if none
+    // holds one. Ties go to the lowest-numbered lane.
+    int oldestLane(int vclass, ClassQueue* const queues[]) const {
+        int best = -1;
+        int64_t bestArrival = 0;
+        for (unsigned m = laneMask[vclass]; m; m &= m - 1) {
+            int lane = __builtin_ctz(m);
+            int64_t arrival = queues[lane]->peek(vclass).arrivalTime;
+            if (best < 0 || arrival < bestArrival) {
+                best = lane;
+                bestArrival = arrival;
+            }
+        }
+        return best;
+    }
+};
+
 // Lane class to represent a lane with priority
 class Lane {
 public:
     std::string name;
-    Queue<Vehicle>* vehicleQueue;
+    ClassQueue* vehicleQueue;
     int priority;
     bool isPriorityLane;
     
-    Lane() : name(""), vehicleQueue(new Queue<Vehicle>()), priority(0), isPriorityLane(false) {}
+    Lane() : name(""), vehicleQueue(new ClassQueue()), priority(0), isPriorityLane(false) {}
     
     Lane(std::string n, bool isPriority = false) 
-        : name(n), vehicleQueue(new Queue<Vehicle>()), priority(0), isPriorityLane(isPriority) {}
+        : name(n), vehicleQueue(new ClassQueue()), priority(0), isPriorityLane(isPriority) {}
     
     ~Lane() {
         delete vehicleQueue;
@@ -121,10 +419,15 @@ public:
     }
     
     void updatePriority() {
-        if (isPriorityLane && vehicleQueue->size() > 10) {
-            priority = 100; // High priority
+        int top = vehicleQueue->topClass();
+        if (top == CLASS_EMERGENCY) {
+            priority = PRIORITY_EMERGENCY;
+        } else if (top == CLASS_TRANSIT) {
+            priority = PRIORITY_TRANSIT;
+        } else if (isPriorityLane && vehicleQueue->size() > 10) {
+            priority = PRIORITY_CONGESTED; // High priority
         } else {
-            priority = 0; // Normal priority
+            priority = PRIORITY_NORMAL; // Normal priority
         }
     }
 };
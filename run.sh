@@ -18,9 +18,10 @@ if [ ! -f "traf" ] || [ ! -f "sim" ]; then
     echo ""
 fi
 
-# Clean old lane files
+# Clean old lane files, including any renamed aside for ingest.
+# sim.snapshot is kept so the simulator warm-restarts; delete it for a cold start.
 echo "Cleaning old lane files..."
-rm -f lanea.txt laneb.txt lanec.txt laned.txt
+rm -f lanea.txt laneb.txt lanec.txt laned.txt lane*.txt.ingest
 touch lanea.txt laneb.txt lanec.txt laned.txt
 
 
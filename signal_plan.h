@@ -0,0 +1,103 @@
+#ifndef SIGNAL_PLAN_H
+#define SIGNAL_PLAN_H
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "queue.h"
+#include "lane_parser.h"
+
+// Controller timing shared by the simulator and the offline optimizer
+const int DISPATCH_INTERVAL_MS = 500; // One vehicle through the junction per interval
+const int DEFAULT_GREEN_MS = 2000;
+const int PRIORITY_START = 10;        // AL2 queue length that starts the override
+const int PRIORITY_END = 5;           // ...and that ends it
+
+// A signal plan is a cycle of phases, each giving one lane the green light
+// for a fixed time. The AL2 congestion override and vehicle-class preemption
+// still take precedence over the plan.
+struct SignalPhase {
+    int lane;
+    int greenMs;
+};
+
+struct SignalPlan {
+    std::vector<SignalPhase> phases;
+
+    int cycleMs() const {
+        int total = 0;
+        for (size_t i = 0; i < phases.size(); i++) total += phases[i].greenMs;
+        return total;
+    }
+};
+
+// Round robin over every lane with equal greens, the built-in behaviour
+inline SignalPlan defaultSignalPlan() {
+    SignalPlan plan;
+    for (int i = 0; i < NUM_LANES; i++) {
+        SignalPhase p = {i, DEFAULT_GREEN_MS};
+        plan.phases.push_back(p);
+    }
+    return plan;
+}
+
+inline int laneFromLabel(const char* s, size_t len) {
+    for (int i = 0; i < NUM_LANES; i++) {
+        if (std::strlen(LANE_LABELS[i]) == len && std::memcmp(LANE_LABELS[i], s, len) == 0) return i;
+    }
+    return -1;
+}
+
+// Plan files hold one "LANE,GREEN_MS" line per phase in cycle order; blank
+// lines and lines starting with '#' are ignored. Returns false if the file
+// cannot be read, holds a malformed line or leaves any lane without a phase
+// (its vehicles would never get a green).
+inline bool loadSignalPlan(const char* path, SignalPlan& out) {
+    std::ifstream f(path);
+    if (!f.is_open()) return false;
+
+    SignalPlan plan;
+    unsigned served = 0;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#') continue;
+
+        size_t comma = line.find(',');
+        if (comma == std::string::npos) return false;
+
+        int lane = laneFromLabel(line.data(), comma);
+        int64_t green;
+        if (lane < 0 || !parseInt64(line.data() + comma + 1, line.data() + line.size(), green) ||
+            green <= 0 || green > INT_MAX) {
+            return false;
+        }
+
+        SignalPhase p = {lane, (int)green};
+        plan.phases.push_back(p);
+        served |= 1u << lane;
+    }
+    if (served != (1u << NUM_LANES) - 1) return false;
+
+    out = plan;
+    return true;
+}
+
+inline bool saveSignalPlan(const char* path, const SignalPlan& plan, const std::string& comment) {
+    std::ofstream f(path, std::ofstream::trunc);
+    if (!f.is_open()) return false;
+
+    f << "# " << comment << "\n";
+    f << "# lane,green_ms\n";
+    for (size_t i = 0; i < plan.phases.size(); i++) {
+        f << LANE_LABELS[plan.phases[i].lane] << "," << plan.phases[i].greenMs << "\n";
+    }
+    return f.good();
+}
+
+#endif
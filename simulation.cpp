@@ -1,73 +1,212 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <cstdio>
 #include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <ctime>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
 
 #include "queue.h"
+#include "lane_parser.h"
+#include "lane_watcher.h"
+#include "snapshot.h"
+#include "metrics.h"
+#include "history.h"
+#include "signal_plan.h"
+#include "frame_capture.h"
 
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 800;
 const int CAR_SIZE = 24;
 const float MAX_SPEED = 4.0f;
+const Uint32 FRAME_MS = 16;
+
+// Junction Geometry
+// One entry per approach, indexed by laneIndex. Cars travel along `axis` in
+// direction `dir` and queue back from `stopLine`; every per-lane kernel below
+// is instantiated from this table so there are no runtime lane branches.
+const int AXIS_X = 0;
+const int AXIS_Y = 1;
+const float QUEUE_SPACING = 32.0f;
+const float STOP_TOLERANCE = 5.0f;
+const float EXIT_SPEED = MAX_SPEED * 1.5f;
+
+struct Approach {
+    const char* label;
+    int axis;
+    int dir;               // +1 = increasing coordinate, -1 = decreasing
+    float spawnX, spawnY;
+    float stopLine;
+    int lightX, lightY;
+    int headX[2], headY[2]; // Headlight offsets within the car box
+};
 
-// Logic Thresholds
-const int PRIORITY_START = 10;
-const int PRIORITY_END = 5;
+constexpr Approach APPROACHES[4] = {
+    {LANE_LABELS[LANE_A], AXIS_Y, +1, 360, -50, 280, 240, 240, {4, CAR_SIZE-4}, {CAR_SIZE-2, CAR_SIZE-2}}, // A (North), facing down
+    {LANE_LABELS[LANE_B], AXIS_X, -1, 850, 360, 520, 540, 240, {2, 2}, {4, CAR_SIZE-4}},                   // B (East), facing left
+    {LANE_LABELS[LANE_C], AXIS_Y, -1, 420, 850, 520, 540, 540, {4, CAR_SIZE-4}, {2, 2}},                   // C (South), facing up
+    {LANE_LABELS[LANE_D], AXIS_X, +1, -50, 420, 280, 240, 540, {CAR_SIZE-2, CAR_SIZE-2}, {4, CAR_SIZE-4}}, // D (West), facing right
+};
 
 
 SDL_Window* window = nullptr;
 SDL_Renderer* renderer = nullptr;
+SDL_Surface* frameSurface = nullptr; // Render target in headless mode
 TTF_Font* font = nullptr;
 TTF_Font* fontLarge = nullptr;
 
 // Data Structures
 Lane* pqLanes[4]; // 0=A(AL2), 1=B(BL2), 2=C(CL2), 3=D(DL2)
-Queue<Vehicle>* myQueues[4];
+ClassQueue* myQueues[4];
+ClassIndex classIndex; // Lanes holding each vehicle class, kept in step with myQueues
 LanePriorityQueue* pq = nullptr;
 
 // Simulation State
 bool priorityMode = false;
-int currentCycleIndex = 0;
+SignalPlan signalPlan = defaultSignalPlan();
+int currentCycleIndex = 0; // Phase of signalPlan currently served
 Uint32 lastCycleTime = 0;
+Uint32 lastDispatch = 0; // Shared across approaches: one car through every DISPATCH_INTERVAL_MS
+int preemptClass = -1; // Class holding the phase, -1 when no transit/emergency vehicle waits
+int preemptLane = -1;
+Uint32 preemptStart = 0; // Start of the current preemption, or of its cooldown
+bool preemptYielding = false;
+const Uint32 PREEMPT_MAX_MS = 8000;      // Longest preemption may hold the junction...
+const Uint32 PREEMPT_COOLDOWN_MS = 4000; // ...before handing it back to the plan for this long
 int totalVehiclesPassed = 0; // New Statistic
 
 // Visualization Data
 struct VisualCar {
-    std::string id;
+    uint64_t id; // Packed, see packVehicleID()
     float x, y;
     float speed;
     int laneIndex;
     int state;
-    std::string laneLabel;
+    int vclass;
+};
+
+std::vector<VisualCar> laneVisuals[4]; // Cars on each approach, front of the queue first
+
+size_t visualCount() {
+    size_t n = 0;
+    for(int i=0; i<4; i++) n += laneVisuals[i].size();
+    return n;
+}
+
+// Warm Restart
+const char* SNAPSHOT_FILE = "sim.snapshot";
+const uint32_t SNAPSHOT_SLOT_BYTES = 512 * 1024;
+const Uint32 SNAPSHOT_INTERVAL_MS = 1000;
+SnapshotStore* snapshots = nullptr;
+Uint32 lastSnapshotTime = 0;
+
+// Lane files are renamed to these while their arrivals are not yet in a snapshot
+const char* INGEST_FILES[] = {"lanea.txt.ingest", "laneb.txt.ingest", "lanec.txt.ingest", "laned.txt.ingest"};
+unsigned ingestHeld = 0;    // Lanes whose .ingest file awaits a successful snapshot
+unsigned ingestSaved = 0;   // Held lanes whose arrivals so far are on disk in a snapshot
+unsigned ingestRecheck = 0; // Lanes to read again once their .ingest file is released
+size_t ingestBytes[4];      // Bytes of each .ingest file already admitted
+
+// Metrics Export
+const char* METRICS_SHM = "/tlq_metrics";
+const char* METRICS_SOCKET = "sim.metrics.sock";
+MetricsPublisher* metrics = nullptr;
+
+// Long-run History
+TrafficHistory history;
+
+// Replay / Offscreen Capture
+// In replay mode arrivals come from a recorded log instead of the lane files
+// and the clock advances FRAME_MS per frame, so runs are not tied to real time.
+struct ReplayArrival {
+    int64_t epoch;
+    uint64_t id;
+    int lane;
+    uint8_t vclass;
+};
+
+bool replayMode = false;
+std::vector<ReplayArrival> replayLog;
+size_t replayNext = 0;
+int64_t replayStart = 0;
+Uint32 simFrame = 0;
+FrameCapture* capture = nullptr;
+
+// Simulation clock in ms; real ticks when live, frame-driven when replaying
+Uint32 simTicks() {
+    return replayMode ? simFrame * FRAME_MS : SDL_GetTicks();
+}
+
+// Simulation wall clock in epoch seconds, for arrival and wait times
+time_t simNow() {
+    return replayMode ? (time_t)(replayStart + simTicks() / 1000) : time(nullptr);
+}
+
+// Image layout: SnapshotState, then each lane queue's Vehicles front to back,
+// then the VisualCars. Timers are stored as ages since SDL ticks restart at 0.
+// Bump SNAPSHOT_LAYOUT whenever any of these structs changes.
+const uint32_t SNAPSHOT_LAYOUT = 2; // 2: vehicle classes
+
+struct SnapshotState {
+    uint32_t layout;
+    int32_t priorityMode;
+    int32_t currentCycleIndex;
+    int32_t totalVehiclesPassed;
+    uint32_t cycleAgeMs;
+    uint32_t dispatchAgeMs;
+    uint32_t queueCounts[4];
+    uint32_t visualCount;
 };
 
-std::vector<VisualCar> trafficVisuals;
+static_assert(std::is_trivially_copyable<VisualCar>::value, "VisualCar is snapshotted with memcpy");
+
+// Coordinate a car on approach L moves along
+template <int L>
+inline float& travelCoord(VisualCar& c) {
+    return APPROACHES[L].axis == AXIS_Y ? c.y : c.x;
+}
+
+// Stop position for the qIdx-th car waiting on approach L
+template <int L>
+inline float queueTarget(int qIdx) {
+    return APPROACHES[L].stopLine - APPROACHES[L].dir * (qIdx * QUEUE_SPACING);
+}
 
 
-bool carExists(std::string id) {
-    for(const auto& c : trafficVisuals) if(c.id == id) return true;
+bool carExists(uint64_t id) {
+    for(int i=0; i<4; i++) {
+        for(const auto& c : laneVisuals[i]) if(c.id == id) return true;
+    }
     return false;
 }
 
 // Counts visually waiting cars for logic triggers
 int getVisualQueueCount(int laneIdx) {
     int count = 0;
-    for(const auto& c : trafficVisuals) {
-        if(c.laneIndex == laneIdx && c.state == 1) count++;
+    for(const auto& c : laneVisuals[laneIdx]) {
+        if(c.state == 1) count++;
     }
     return count;
 }
 
-void initSDL() {
-    SDL_Init(SDL_INIT_VIDEO);
-    TTF_Init();
-    window = SDL_CreateWindow("Traffic Control System", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+void initSDL(bool headless) {
+    if(headless) {
+        // Software renderer drawing into a plain surface, no window or display
+        SDL_Init(0);
+        TTF_Init();
+        frameSurface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGB888);
+        if(frameSurface) renderer = SDL_CreateSoftwareRenderer(frameSurface);
+    } else {
+        SDL_Init(SDL_INIT_VIDEO);
+        TTF_Init();
+        window = SDL_CreateWindow("Traffic Control System", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    }
 
     // Load Fonts
     font = TTF_OpenFont("/usr/share/fonts/TTF/DejaVuSans.ttf", 18);
@@ -79,39 +218,272 @@ void initSDL() {
 
 
 
-void loadTraffic() {
-    std::string files[] = {"lanea.txt", "laneb.txt", "lanec.txt", "laned.txt"};
-    std::string labels[] = {"AL2", "BL2", "CL2", "DL2"};
+// Writes the current state to the snapshot store, waiting for it to reach
+// the disk while lane files are held on its behalf. Returns false, keeping
+// the previous image, if it was not written.
+bool saveSnapshot() {
+    static std::vector<char> image;
+    Uint32 now = simTicks();
+    lastSnapshotTime = now;
+    if(!snapshots || !snapshots->isOpen()) return false;
+
+    SnapshotState st;
+    st.layout = SNAPSHOT_LAYOUT;
+    st.priorityMode = priorityMode;
+    st.currentCycleIndex = currentCycleIndex;
+    st.totalVehiclesPassed = totalVehiclesPassed;
+    st.cycleAgeMs = now - lastCycleTime;
+    st.dispatchAgeMs = now - lastDispatch;
+    for(int i=0; i<4; i++) st.queueCounts[i] = myQueues[i]->size();
+    st.visualCount = visualCount();
+
+    image.resize(sizeof(st));
+    std::memcpy(image.data(), &st, sizeof(st));
+    for(int i=0; i<4; i++) {
+        myQueues[i]->forEach([](const Vehicle& v) {
+            const char* p = reinterpret_cast<const char*>(&v);
+            image.insert(image.end(), p, p + sizeof(Vehicle));
+        });
+    }
+    for(int i=0; i<4; i++) {
+        const char* cars = reinterpret_cast<const char*>(laneVisuals[i].data());
+        image.insert(image.end(), cars, cars + laneVisuals[i].size() * sizeof(VisualCar));
+    }
+
+    if(image.size() > snapshots->capacity()) {
+        std::cerr << "Snapshot: state (" << image.size() << " bytes) exceeds slot, keeping previous image" << std::endl;
+        return false;
+    }
+    if(!snapshots->save(image.data(), image.size(), ingestHeld != 0)) return false;
+
+    ingestSaved |= ingestHeld;
+    return true;
+}
+
+// Restores queues, visuals and controller state from the newest snapshot.
+// Returns false and leaves everything untouched if there is none.
+bool restoreSnapshot() {
+    std::vector<char> image;
+    if(!snapshots || !snapshots->load(image) || image.size() < sizeof(SnapshotState)) return false;
+
+    SnapshotState st;
+    std::memcpy(&st, image.data(), sizeof(st));
+    if(st.layout != SNAPSHOT_LAYOUT) return false;
+
+    size_t vehicles = 0;
+    for(int i=0; i<4; i++) vehicles += st.queueCounts[i];
+    if(image.size() != sizeof(st) + vehicles * sizeof(Vehicle) + (size_t)st.visualCount * sizeof(VisualCar)) return false;
+    // A plan with fewer phases may have been loaded since; restart its cycle
+    if(st.currentCycleIndex < 0 || st.currentCycleIndex >= (int)signalPlan.phases.size()) {
+        st.currentCycleIndex = 0;
+        st.cycleAgeMs = 0;
+    }
+
+    const char* queued = image.data() + sizeof(st);
+    const char* cars = queued + vehicles * sizeof(Vehicle);
+
+    for(uint32_t n=0; n<st.visualCount; n++) {
+        VisualCar c;
+        std::memcpy(&c, cars + n * sizeof(c), sizeof(c));
+        if(c.laneIndex < 0 || c.laneIndex >= 4 || c.vclass < 0 || c.vclass >= NUM_CLASSES) continue;
+        laneVisuals[c.laneIndex].push_back(c);
+    }
 
+    // Only queue vehicles whose car survived, so dispatch never pops a
+    // vehicle that has nothing on screen to release...
+    std::vector<uint64_t> queuedIds;
     for(int i=0; i<4; i++) {
-        std::ifstream f(files[i]);
-        if(!f.is_open()) continue;
-
-        std::string line;
-        while(std::getline(f, line)) {
-            if(line.empty()) continue;
-            std::stringstream ss(line);
-            std::string id, tStr, lName;
-            std::getline(ss, id, ','); std::getline(ss, tStr, ','); std::getline(ss, lName, ',');
-
-            if(!carExists(id)) {
-                Vehicle v(id, (time_t)std::stoi(tStr), lName);
-                myQueues[i]->enqueue(v);
-
-                VisualCar vc;
-                vc.id = id; vc.laneIndex = i; vc.laneLabel = labels[i];
-                vc.state = 0; vc.speed = MAX_SPEED;
-
-                if(i == 0) { vc.x = 360; vc.y = -50; }       // A (North)
-                else if(i == 1) { vc.x = 850; vc.y = 360; }  // B (East)
-                else if(i == 2) { vc.x = 420; vc.y = 850; }  // C (South)
-                else if(i == 3) { vc.x = -50; vc.y = 420; }  // D (West)
-
-                trafficVisuals.push_back(vc);
+        for(uint32_t n=0; n<st.queueCounts[i]; n++) {
+            Vehicle v;
+            std::memcpy(&v, queued, sizeof(v));
+            queued += sizeof(v);
+            if(v.vclass >= NUM_CLASSES) continue;
+
+            bool hasCar = false;
+            for(const auto& c : laneVisuals[i]) {
+                if(c.id == v.id && c.vclass == v.vclass) { hasCar = true; break; }
             }
+            if(!hasCar) continue;
+            myQueues[i]->enqueue(v);
+            queuedIds.push_back(v.id);
         }
-        f.close();
-        std::ofstream clear(files[i], std::ofstream::trunc);
+        classIndex.update(i, *myQueues[i]);
+    }
+
+    // ...and drop waiting cars whose vehicle did not survive
+    std::sort(queuedIds.begin(), queuedIds.end());
+    for(int i=0; i<4; i++) {
+        auto orphan = std::remove_if(laneVisuals[i].begin(), laneVisuals[i].end(), [&](const VisualCar& c){
+            return c.state != 2 && !std::binary_search(queuedIds.begin(), queuedIds.end(), c.id);
+        });
+        laneVisuals[i].erase(orphan, laneVisuals[i].end());
+    }
+
+    Uint32 now = simTicks();
+    priorityMode = st.priorityMode != 0;
+    currentCycleIndex = st.currentCycleIndex;
+    totalVehiclesPassed = st.totalVehiclesPassed;
+    lastCycleTime = now - st.cycleAgeMs;
+    lastDispatch = now - st.dispatchAgeMs;
+    return true;
+}
+
+// Queues a new arrival on lane i and spawns its car; repeats are ignored
+void admitVehicle(int i, uint64_t id, int64_t epoch, uint8_t vclass) {
+    if(carExists(id)) return;
+
+    myQueues[i]->enqueue(Vehicle(id, epoch, (uint8_t)i, vclass));
+    classIndex.update(i, *myQueues[i]);
+    if(metrics) metrics->recordArrival(i);
+    history.recordArrival(i, simNow());
+
+    VisualCar vc;
+    vc.id = id; vc.laneIndex = i; vc.vclass = vclass;
+    vc.state = 0; vc.speed = MAX_SPEED;
+    vc.x = APPROACHES[i].spawnX; vc.y = APPROACHES[i].spawnY;
+
+    laneVisuals[i].push_back(vc);
+}
+
+// Loads recorded lane logs for replay, ordered by arrival time
+bool loadReplay(const std::vector<std::string>& files) {
+    std::vector<char> buf;
+    for(size_t f=0; f<files.size(); f++) {
+        if(!readLaneFile(files[f].c_str(), buf)) {
+            std::cerr << "Cannot open replay log " << files[f] << std::endl;
+            return false;
+        }
+        parseLaneRecords(buf.data(), buf.size(),
+            [](const char* idPtr, size_t idLen, int64_t epoch, const char* lanePtr, size_t laneLen,
+               const char* clsPtr, size_t clsLen) {
+                int lane = laneFromLabel(lanePtr, laneLen);
+                if(lane < 0 || idLen > VEHICLE_ID_LEN) return;
+                ReplayArrival a = {epoch, packVehicleID(idPtr, idLen), lane, classFromLabel(clsPtr, clsLen)};
+                replayLog.push_back(a);
+            });
+    }
+    std::stable_sort(replayLog.begin(), replayLog.end(), [](const ReplayArrival& a, const ReplayArrival& b){
+        return a.epoch < b.epoch;
+    });
+    if(!replayLog.empty()) replayStart = replayLog[0].epoch;
+    return true;
+}
+
+// Admits every replayed arrival that is due by the simulation clock
+void injectReplay() {
+    while(replayNext < replayLog.size() && replayLog[replayNext].epoch <= simNow()) {
+        const ReplayArrival& a = replayLog[replayNext++];
+        admitVehicle(a.lane, a.id, a.epoch, a.vclass);
+    }
+}
+
+const char* LANE_FILES[] = {"lanea.txt", "laneb.txt", "lanec.txt", "laned.txt"};
+
+// Admits the records in one chunk of lane i's file
+void ingestRecords(int i, const char* data, size_t len) {
+    parseLaneRecords(data, len,
+        [i](const char* idPtr, size_t idLen, int64_t epoch, const char* /*lane*/, size_t /*laneLen*/,
+            const char* clsPtr, size_t clsLen) {
+            if(idLen > VEHICLE_ID_LEN) return;
+            admitVehicle(i, packVehicleID(idPtr, idLen), epoch, classFromLabel(clsPtr, clsLen));
+        });
+}
+
+// Removes the .ingest files whose arrivals are in a saved snapshot. A
+// generator that opened the lane file just before it was renamed may still
+// have appended to it; those lines are admitted instead and the file is kept
+// until a snapshot holds them too.
+void releaseIngest() {
+    static std::vector<char> buf;
+    for(int i=0; i<4; i++) {
+        if(!(ingestSaved & (1u << i))) continue;
+
+        if(readLaneFile(INGEST_FILES[i], buf) && buf.size() > ingestBytes[i]) {
+            // Only whole lines; a partial one is picked up next time
+            size_t end = buf.size();
+            while(end > ingestBytes[i] && buf[end - 1] != '\n') end--;
+            ingestRecords(i, buf.data() + ingestBytes[i], end - ingestBytes[i]);
+            ingestBytes[i] = end;
+            ingestSaved &= ~(1u << i);
+            continue;
+        }
+        std::remove(INGEST_FILES[i]);
+        ingestHeld &= ~(1u << i);
+        ingestSaved &= ~(1u << i);
+    }
+}
+
+// Ingests the lanes whose bit is set in laneMask (bit i = LANE_FILES[i]).
+// Each lane file is renamed to its .ingest name before it is read, so the
+// generator starts a fresh file. The .ingest file is only removed a frame
+// after a snapshot holding its arrivals is saved (see releaseIngest()); until
+// then the lane is held and later changes to it wait. A .ingest file left
+// behind by a crash is read first, with repeats dropped by carExists().
+void loadTraffic(unsigned laneMask) {
+    static std::vector<char> buf;
+    releaseIngest();
+
+    unsigned lanes = (laneMask | ingestRecheck) & ~ingestHeld;
+    ingestRecheck = (ingestRecheck | laneMask) & ingestHeld;
+    unsigned consumed = 0;
+
+    for(int i=0; i<4; i++) {
+        if(!(lanes & (1u << i))) continue;
+
+        if(readLaneFile(INGEST_FILES[i], buf)) {
+            ingestRecheck |= 1u << i; // Leftover; the lane file is taken next pass
+        } else if(std::rename(LANE_FILES[i], INGEST_FILES[i]) != 0 || !readLaneFile(INGEST_FILES[i], buf)) {
+            continue;
+        }
+
+        ingestRecords(i, buf.data(), buf.size());
+        ingestBytes[i] = buf.size();
+        consumed |= 1u << i;
+    }
+
+    // Persist the new arrivals before their only other copy is removed.
+    // Without a snapshot store there is nothing to wait for.
+    if(!consumed) return;
+    ingestHeld |= consumed;
+    ingestSaved &= ~consumed;
+    if(!snapshots || !snapshots->isOpen()) ingestSaved |= consumed;
+    else saveSnapshot();
+}
+
+// Samples queue lengths into the history and publishes the live metrics
+void recordStats() {
+    uint32_t depths[4];
+    double waitP95[4];
+    int greenLane = -1;
+    Lane* active = pq->peek();
+    for(int i=0; i<4; i++) {
+        depths[i] = myQueues[i]->size();
+        if(pqLanes[i] == active) greenLane = i;
+    }
+    history.sample(simNow(), depths);
+
+    if(!metrics) return;
+    for(int i=0; i<4; i++) {
+        int p95 = history.summarize(i, TIER_SECOND, 60).waitPercentile(0.95);
+        waitP95[i] = p95 == WAIT_NONE ? NAN : p95 == WAIT_OPEN_BIN ? INFINITY : p95;
+    }
+    metrics->publish(depths, waitP95, greenLane, priorityMode, totalVehiclesPassed, simTicks());
+}
+
+// Sleeps until FRAME_MS after frameStart, ingesting arrivals as soon as their
+// lane file changes instead of at the next frame
+void waitForNextFrame(LaneWatcher& watcher, Uint32 frameStart) {
+    if(!watcher.isActive()) {
+        SDL_Delay(FRAME_MS);
+        return;
+    }
+
+    while(true) {
+        Uint32 elapsed = SDL_GetTicks() - frameStart;
+        if(elapsed >= FRAME_MS) break;
+
+        unsigned changed = watcher.wait(FRAME_MS - elapsed);
+        if(changed) loadTraffic(changed);
     }
 }
 
@@ -122,86 +494,117 @@ void updateLogic() {
         priorityMode = true;
     } else if(priorityMode && countA < PRIORITY_END) {
         priorityMode = false;
-        lastCycleTime = SDL_GetTicks();
+        lastCycleTime = simTicks();
     }
 
-    for(int i=0; i<4; i++) pqLanes[i]->priority = 0;
+    // Transit and emergency vehicles preempt the phase, highest class first,
+    // on the lane where such a vehicle has waited longest. Preemption yields
+    // after PREEMPT_MAX_MS so a vehicle deep in a long queue cannot hold the
+    // other approaches on red indefinitely.
+    Uint32 now = simTicks();
+    int topClass = classIndex.highestClass();
+    int wantClass = topClass > CLASS_NORMAL ? topClass : -1;
+    if(preemptYielding && now - preemptStart >= PREEMPT_COOLDOWN_MS) preemptYielding = false;
+
+    if(wantClass < 0 || preemptYielding) {
+        preemptClass = preemptLane = -1;
+    } else {
+        if(preemptLane < 0) preemptStart = now;
+        if(now - preemptStart >= PREEMPT_MAX_MS) {
+            preemptYielding = true;
+            preemptStart = now;
+            preemptClass = preemptLane = -1;
+        } else {
+            preemptClass = wantClass;
+            preemptLane = classIndex.oldestLane(wantClass, myQueues);
+        }
+    }
+
+    for(int i=0; i<4; i++) pqLanes[i]->priority = PRIORITY_NORMAL;
 
     if(priorityMode) {
-        pqLanes[0]->priority = 100;
+        pqLanes[0]->priority = PRIORITY_CONGESTED;
     } else {
-        if(SDL_GetTicks() - lastCycleTime > 2000) {
-            currentCycleIndex = (currentCycleIndex + 1) % 4;
-            lastCycleTime = SDL_GetTicks();
+        if(simTicks() - lastCycleTime > (Uint32)signalPlan.phases[currentCycleIndex].greenMs) {
+            currentCycleIndex = (currentCycleIndex + 1) % signalPlan.phases.size();
+            lastCycleTime = simTicks();
         }
-        pqLanes[currentCycleIndex]->priority = 50;
+        pqLanes[signalPlan.phases[currentCycleIndex].lane]->priority = PRIORITY_CYCLE;
+    }
+
+    if(preemptLane >= 0) {
+        pqLanes[preemptLane]->priority = (preemptClass == CLASS_EMERGENCY) ? PRIORITY_EMERGENCY : PRIORITY_TRANSIT;
     }
 
     while(!pq->isEmpty()) pq->extractMax();
     for(int i=0; i<4; i++) pq->insert(pqLanes[i]);
 }
 
-void updateVisuals() {
-    Lane* activeLane = pq->extractMax();
-    pq->insert(activeLane);
-
-    int activeIndex = -1;
-    for(int i=0; i<4; i++) {
-        if(pqLanes[i] == activeLane) { activeIndex = i; break; }
-    }
-
-    int qCounts[4] = {0, 0, 0, 0};
+// Advances every car on approach L by one frame and drops those that left
+// the screen. Instantiated once per lane, so direction, axis and stop line
+// fold into constants, and each only walks its own lane's cars.
+template <int L>
+void updateApproach(bool isGreen) {
+    const int dir = APPROACHES[L].dir;
+    int qIdx = 0;
 
-    for(auto& c : trafficVisuals) {
-        bool isGreen = (c.laneIndex == activeIndex);
+    for(auto& c : laneVisuals[L]) {
+        float& pos = travelCoord<L>(c);
 
         if(c.state != 2) {
-            float target = 0;
-            int qIdx = qCounts[c.laneIndex]++;
-            float spacing = 32.0f;
-
-            if(c.laneIndex == 0) target = 280 - (qIdx * spacing);
-            else if(c.laneIndex == 1) target = 520 + (qIdx * spacing);
-            else if(c.laneIndex == 2) target = 520 + (qIdx * spacing);
-            else if(c.laneIndex == 3) target = 280 - (qIdx * spacing);
-
-            float moveStep = c.speed;
+            float target = queueTarget<L>(qIdx);
             bool reached = false;
 
-            if(c.laneIndex == 0) { if(c.y < target-5) c.y += moveStep; else { c.y=target; reached=true; }}
-            else if(c.laneIndex == 1) { if(c.x > target+5) c.x -= moveStep; else { c.x=target; reached=true; }}
-            else if(c.laneIndex == 2) { if(c.y > target+5) c.y -= moveStep; else { c.y=target; reached=true; }}
-            else if(c.laneIndex == 3) { if(c.x < target-5) c.x += moveStep; else { c.x=target; reached=true; }}
+            if(dir * (target - pos) > STOP_TOLERANCE) pos += dir * c.speed;
+            else { pos = target; reached = true; }
 
             c.state = reached ? 1 : 0;
 
             if(isGreen && qIdx == 0 && reached) {
-                static Uint32 lastDispatch = 0;
-                if(SDL_GetTicks() - lastDispatch > 500) {
+                if(simTicks() - lastDispatch > (Uint32)DISPATCH_INTERVAL_MS) {
                     c.state = 2;
-                    lastDispatch = SDL_GetTicks();
-                    if(!myQueues[c.laneIndex]->isEmpty()) myQueues[c.laneIndex]->dequeue();
+                    lastDispatch = simTicks();
+                    if(myQueues[L]->hasClass(c.vclass)) {
+                        Vehicle v = myQueues[L]->dequeue(c.vclass);
+                        classIndex.update(L, *myQueues[L]);
+
+                        time_t now = simNow();
+                        history.recordDeparture(L, now, now - v.arrivalTime);
+                    }
 
                     // INCREMENT STATS
                     totalVehiclesPassed++;
+                    if(metrics) metrics->recordDispatch(L);
                 }
             }
+            qIdx++;
         }
         else {
             // Exiting Movement
-            if(c.laneIndex == 0) c.y += MAX_SPEED * 1.5;
-            else if(c.laneIndex == 1) c.x -= MAX_SPEED * 1.5;
-            else if(c.laneIndex == 2) c.y -= MAX_SPEED * 1.5;
-            else if(c.laneIndex == 3) c.x += MAX_SPEED * 1.5;
+            pos += dir * EXIT_SPEED;
         }
     }
 
-    auto it = std::remove_if(trafficVisuals.begin(), trafficVisuals.end(), [](const VisualCar& c){
+    auto it = std::remove_if(laneVisuals[L].begin(), laneVisuals[L].end(), [](const VisualCar& c){
         return c.x < -100 || c.x > 900 || c.y < -100 || c.y > 900;
     });
-    trafficVisuals.erase(it, trafficVisuals.end());
+    laneVisuals[L].erase(it, laneVisuals[L].end());
 }
 
+void updateVisuals() {
+    Lane* activeLane = pq->extractMax();
+    pq->insert(activeLane);
+
+    int activeIndex = -1;
+    for(int i=0; i<4; i++) {
+        if(pqLanes[i] == activeLane) { activeIndex = i; break; }
+    }
+
+    updateApproach<0>(activeIndex == 0);
+    updateApproach<1>(activeIndex == 1);
+    updateApproach<2>(activeIndex == 2);
+    updateApproach<3>(activeIndex == 3);
+}
 
 void drawRect(int x, int y, int w, int h, int r, int g, int b) {
     SDL_SetRenderDrawColor(renderer, r, g, b, 255);
@@ -275,54 +678,45 @@ void render() {
     pq->insert(active);
 
     // 7. Traffic Lights (with housings)
-    struct LPos { int x, y; std::string n; };
-    LPos lights[] = {{240, 240, "AL2"}, {540, 240, "BL2"}, {540, 540, "CL2"}, {240, 540, "DL2"}};
-
     for(int i=0; i<4; i++) {
+        const Approach& a = APPROACHES[i];
+
         // Housing
-        drawRect(lights[i].x, lights[i].y, 30, 30, 20, 20, 20);
+        drawRect(a.lightX, a.lightY, 30, 30, 20, 20, 20);
 
         // Light Bulb
         bool isGreen = (pqLanes[i] == active);
-        if(isGreen) drawRect(lights[i].x+5, lights[i].y+5, 20, 20, 0, 255, 0); // Green
-        else drawRect(lights[i].x+5, lights[i].y+5, 20, 20, 255, 0, 0);       // Red
+        if(isGreen) drawRect(a.lightX+5, a.lightY+5, 20, 20, 0, 255, 0); // Green
+        else drawRect(a.lightX+5, a.lightY+5, 20, 20, 255, 0, 0);       // Red
 
         // Lane Label
-        drawText(lights[i].x, lights[i].y - 20, lights[i].n, font, {255, 255, 255});
+        drawText(a.lightX, a.lightY - 20, a.label, font, {255, 255, 255});
     }
 
     // 8. Vehicles with Headlights
-    for(const auto& c : trafficVisuals) {
+    for(int i=0; i<4; i++) for(const auto& c : laneVisuals[i]) {
         // Body
         SDL_Rect carBox = {(int)c.x, (int)c.y, CAR_SIZE, CAR_SIZE};
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Border
         SDL_RenderDrawRect(renderer, &carBox);
 
         // Color
-        if(c.laneIndex == 0) drawRect(c.x+1, c.y+1, CAR_SIZE-2, CAR_SIZE-2, 255, 215, 0); // Gold
+        if(c.vclass == CLASS_EMERGENCY) drawRect(c.x+1, c.y+1, CAR_SIZE-2, CAR_SIZE-2, 220, 20, 60); // Crimson
+        else if(c.vclass == CLASS_TRANSIT) drawRect(c.x+1, c.y+1, CAR_SIZE-2, CAR_SIZE-2, 255, 140, 0); // Orange
+        else if(c.laneIndex == 0) drawRect(c.x+1, c.y+1, CAR_SIZE-2, CAR_SIZE-2, 255, 215, 0); // Gold
         else drawRect(c.x+1, c.y+1, CAR_SIZE-2, CAR_SIZE-2, 65, 105, 225); // Royal Blue
 
         // Headlights (Yellow dots indicating direction)
+        const Approach& a = APPROACHES[c.laneIndex];
         SDL_SetRenderDrawColor(renderer, 255, 255, 100, 255);
-        if(c.laneIndex == 0) { // Facing Down
-            SDL_RenderDrawPoint(renderer, c.x+4, c.y+CAR_SIZE-2);
-            SDL_RenderDrawPoint(renderer, c.x+CAR_SIZE-4, c.y+CAR_SIZE-2);
-        } else if(c.laneIndex == 1) { // Facing Left
-            SDL_RenderDrawPoint(renderer, c.x+2, c.y+4);
-            SDL_RenderDrawPoint(renderer, c.x+2, c.y+CAR_SIZE-4);
-        } else if(c.laneIndex == 2) { // Facing Up
-            SDL_RenderDrawPoint(renderer, c.x+4, c.y+2);
-            SDL_RenderDrawPoint(renderer, c.x+CAR_SIZE-4, c.y+2);
-        } else if(c.laneIndex == 3) { // Facing Right
-            SDL_RenderDrawPoint(renderer, c.x+CAR_SIZE-2, c.y+4);
-            SDL_RenderDrawPoint(renderer, c.x+CAR_SIZE-2, c.y+CAR_SIZE-4);
-        }
+        SDL_RenderDrawPoint(renderer, c.x+a.headX[0], c.y+a.headY[0]);
+        SDL_RenderDrawPoint(renderer, c.x+a.headX[1], c.y+a.headY[1]);
     }
 
 
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
-    SDL_Rect hud = {10, 10, 280, 120};
+    SDL_Rect hud = {10, 10, 280, 145};
     SDL_RenderFillRect(renderer, &hud);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
 
@@ -331,6 +725,10 @@ void render() {
 
     std::string modeStr = priorityMode ? "Mode: PRIORITY (AL2)" : "Mode: NORMAL";
     SDL_Color modeCol = priorityMode ? SDL_Color{255, 100, 100} : SDL_Color{100, 255, 100};
+    if(preemptLane >= 0) {
+        modeStr = std::string(preemptClass == CLASS_EMERGENCY ? "Mode: EMERGENCY (" : "Mode: TRANSIT (") + LANE_LABELS[preemptLane] + ")";
+        modeCol = SDL_Color{255, 140, 0};
+    }
     drawText(20, 50, modeStr, font, modeCol);
 
     std::string greenStr = "Green Lane: " + active->name;
@@ -339,37 +737,137 @@ void render() {
     std::string totalStr = "Passed Vehicles: " + std::to_string(totalVehiclesPassed);
     drawText(20, 100, totalStr, font, {200, 200, 255});
 
+    int p95 = history.summarize(-1, TIER_SECOND, 60).waitPercentile(0.95);
+    std::string waitStr = "Wait p95 (1 min): " + (p95 == WAIT_NONE ? std::string("-")
+                        : p95 == WAIT_OPEN_BIN ? ">=" + std::to_string(WAIT_BIN_LIMITS[WAIT_BINS - 2]) + "s"
+                        : "<" + std::to_string(p95) + "s");
+    drawText(20, 125, waitStr, font, {200, 200, 255});
+
     SDL_RenderPresent(renderer);
 }
 
 
 
 int main(int argc, char* args[]) {
-    initSDL();
+    bool headless = false;
+    int captureEvery = 1;
+    std::string planPath, capturePath;
+    std::vector<std::string> replayFiles;
+
+    for(int i=1; i<argc; i++) {
+        std::string arg = args[i];
+        if(arg == "--headless") headless = true;
+        else if(arg == "--plan" && i+1 < argc) planPath = args[++i];              // e.g. written by the offline optimizer
+        else if(arg == "--replay" && i+1 < argc) replayFiles.push_back(args[++i]); // Recorded lane log, repeatable
+        else if(arg == "--capture" && i+1 < argc) capturePath = args[++i];        // .y4m stream or PPM prefix
+        else if(arg == "--capture-every" && i+1 < argc) captureEvery = std::max(1, atoi(args[++i]));
+        else {
+            std::cerr << "Usage: " << args[0] << " [--plan plan.txt] [--headless --capture out.y4m [--capture-every N]] [--replay lane.txt]..." << std::endl;
+            return 1;
+        }
+    }
+
+    // Optional timing plan
+    if(!planPath.empty()) {
+        if(!loadSignalPlan(planPath.c_str(), signalPlan)) {
+            std::cerr << "Cannot load signal plan " << planPath
+                      << " (expects LANE,GREEN_MS lines giving every lane a phase)" << std::endl;
+            return 1;
+        }
+        std::cout << "Loaded " << signalPlan.phases.size() << "-phase signal plan from " << planPath << std::endl;
+    }
+
+    if(headless && capturePath.empty()) {
+        std::cerr << "--headless needs --capture" << std::endl;
+        return 1;
+    }
+
+    replayMode = !replayFiles.empty();
+    if(replayMode && !loadReplay(replayFiles)) return 1;
+
+    initSDL(headless);
+    if(!renderer) {
+        std::cerr << "Renderer creation failed: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    if(!capturePath.empty()) {
+        if(!frameSurface) {
+            std::cerr << "--capture needs --headless" << std::endl;
+            return 1;
+        }
+        // One captured frame per captureEvery frames of FRAME_MS
+        capture = new FrameCapture(capturePath, SCREEN_WIDTH, SCREEN_HEIGHT, 1000, FRAME_MS * captureEvery);
+        if(!capture->isOpen()) {
+            std::cerr << "Cannot write " << capturePath << std::endl;
+            return 1;
+        }
+    }
 
     // Init Logic
-    pqLanes[0] = new Lane("AL2", true);
-    pqLanes[1] = new Lane("BL2", false);
-    pqLanes[2] = new Lane("CL2", false);
-    pqLanes[3] = new Lane("DL2", false);
+    for(int i=0; i<4; i++) pqLanes[i] = new Lane(APPROACHES[i].label, i == 0);
 
-    for(int i=0; i<4; i++) myQueues[i] = new Queue<Vehicle>();
+    for(int i=0; i<4; i++) myQueues[i] = new ClassQueue();
 
     pq = new LanePriorityQueue(10);
     for(int i=0; i<4; i++) pq->insert(pqLanes[i]);
 
+    // Replays leave the live junction's snapshot and metrics alone
+    if(!replayMode) {
+        snapshots = new SnapshotStore(SNAPSHOT_FILE, SNAPSHOT_SLOT_BYTES);
+        if(restoreSnapshot()) {
+            std::cout << "Restored " << visualCount() << " vehicles from " << SNAPSHOT_FILE << std::endl;
+        }
+
+        metrics = new MetricsPublisher(METRICS_SHM, METRICS_SOCKET);
+    }
+    // Replays never read the lane files, so they do not watch them
+    LaneWatcher* watcher = replayMode ? nullptr : new LaneWatcher(LANE_FILES, 4);
+
     bool running = true;
     SDL_Event e;
 
     while(running) {
+        Uint32 frameStart = SDL_GetTicks();
         while(SDL_PollEvent(&e)) if(e.type == SDL_QUIT) running = false;
 
-        loadTraffic();
+        if(replayMode) {
+            injectReplay();
+            if(replayNext == replayLog.size() && visualCount() == 0) running = false;
+        } else {
+            loadTraffic(watcher->wait(0));
+        }
         updateLogic();
         updateVisuals();
-        render();
+        if(simTicks() - lastSnapshotTime >= SNAPSHOT_INTERVAL_MS) saveSnapshot();
+        recordStats();
+
+        // Offscreen runs only draw the frames they keep
+        if(!headless || simFrame % captureEvery == 0) {
+            render();
+            if(capture) capture->submit(frameSurface->pixels, frameSurface->pitch);
+        }
+        simFrame++;
 
-        SDL_Delay(16);
+        // Replays run as fast as the frames can be simulated
+        if(watcher) waitForNextFrame(*watcher, frameStart);
     }
+
+    if(capture) {
+        capture->finish();
+        std::cout << "Captured " << capture->framesWritten() << " frames to " << capturePath
+                  << " (" << capture->framesRepeated() << " repeated while the writer caught up)" << std::endl;
+        if(capture->framesDropped() > 0) {
+            std::cerr << "Warning: " << capture->framesDropped() << " frames were lost, so the capture plays back "
+                      << "shorter than the simulation" << std::endl;
+        }
+        delete capture;
+    }
+
+    saveSnapshot();
+    releaseIngest();
+    delete watcher;
+    delete snapshots;
+    delete metrics;
     return 0;
 }
@@ -0,0 +1,157 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Crash-safe store for a single binary state image. The file is mmap'd and
+// holds two slots that are written alternately; a slot only becomes visible
+// once its checksum and sequence number are in place, so a crash mid-write
+// leaves the previous image intact.
+class SnapshotStore {
+private:
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotBytes;
+    };
+
+    struct SlotHeader {
+        uint64_t sequence; // 0 = empty or being written
+        uint64_t checksum;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    static const uint32_t VERSION = 1;
+
+    int fd;
+    char* map;
+    size_t mapBytes;
+    uint32_t slotBytes;
+    uint64_t lastSequence;
+
+    static uint64_t fnv1a(const char* data, size_t len) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < len; i++) {
+            h ^= (uint8_t)data[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    SlotHeader* slot(int i) {
+        return reinterpret_cast<SlotHeader*>(map + sizeof(FileHeader) + (size_t)i * slotBytes);
+    }
+
+    char* slotData(int i) {
+        return reinterpret_cast<char*>(slot(i) + 1);
+    }
+
+    bool slotValid(int i) {
+        SlotHeader* s = slot(i);
+        return s->sequence != 0 && s->length <= capacity() &&
+               s->checksum == fnv1a(slotData(i), s->length);
+    }
+
+    // Index of the newest valid slot, or -1 if there is none
+    int latestSlot() {
+        int best = -1;
+        for (int i = 0; i < 2; i++) {
+            if (slotValid(i) && (best < 0 || slot(i)->sequence > slot(best)->sequence)) best = i;
+        }
+        return best;
+    }
+
+public:
+    // slotBytes is the space reserved per slot, headers included
+    SnapshotStore(const char* path, uint32_t bytesPerSlot)
+        : fd(-1), map(nullptr), mapBytes(0), slotBytes(bytesPerSlot), lastSequence(0) {
+        mapBytes = sizeof(FileHeader) + 2 * (size_t)slotBytes;
+
+        fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0 || ftruncate(fd, mapBytes) != 0) {
+            std::cerr << "Snapshot: cannot open " << path << std::endl;
+            if (fd >= 0) close(fd);
+            fd = -1;
+            return;
+        }
+
+        void* m = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            std::cerr << "Snapshot: cannot map " << path << std::endl;
+            close(fd);
+            fd = -1;
+            return;
+        }
+        map = static_cast<char*>(m);
+
+        // A file from another layout is discarded rather than misread
+        FileHeader* fh = reinterpret_cast<FileHeader*>(map);
+        if (std::memcmp(fh->magic, "TLQSNAP", 8) != 0 || fh->version != VERSION || fh->slotBytes != slotBytes) {
+            std::memset(map, 0, mapBytes);
+            std::memcpy(fh->magic, "TLQSNAP", 8);
+            fh->version = VERSION;
+            fh->slotBytes = slotBytes;
+        }
+
+        int latest = latestSlot();
+        if (latest >= 0) lastSequence = slot(latest)->sequence;
+    }
+
+    ~SnapshotStore() {
+        if (map) {
+            msync(map, mapBytes, MS_SYNC);
+            munmap(map, mapBytes);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    bool isOpen() const {
+        return map != nullptr;
+    }
+
+    // Largest payload a slot can hold
+    uint32_t capacity() const {
+        return slotBytes - (uint32_t)sizeof(SlotHeader);
+    }
+
+    // Copies the newest valid image into out. Returns false if there is none.
+    bool load(std::vector<char>& out) {
+        if (!map) return false;
+        int latest = latestSlot();
+        if (latest < 0) return false;
+
+        out.assign(slotData(latest), slotData(latest) + slot(latest)->length);
+        return true;
+    }
+
+    // Writes an image into the older slot. Returns false if it does not fit.
+    // A durable save waits until the image is on disk and returns false if
+    // that fails; otherwise the kernel writes it back in its own time.
+    bool save(const char* data, uint32_t len, bool durable = false) {
+        if (!map || len > capacity()) return false;
+
+        int target = (int)((lastSequence + 1) % 2);
+        SlotHeader* s = slot(target);
+
+        s->sequence = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(slotData(target), data, len);
+        s->length = len;
+        s->checksum = fnv1a(data, len);
+        std::atomic_thread_fence(std::memory_order_release);
+        s->sequence = ++lastSequence;
+
+        return msync(map, mapBytes, durable ? MS_SYNC : MS_ASYNC) == 0;
+    }
+};
+
+#endif
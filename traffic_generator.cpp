@@ -6,18 +6,28 @@
 #include <chrono>
 #include <thread>
 
-// Function to generate random alphanumeric vehicle ID
-std::string generateVehicleID() {
+#include "queue.h"
+
+// Function to generate random alphanumeric vehicle ID, packed (see packVehicleID)
+uint64_t generateVehicleID() {
     static const char alphanum[] =
         "0123456789"
         "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
         "abcdefghijklmnopqrstuvwxyz";
 
-    std::string id;
-    for (int i = 0; i < 8; ++i) {
-        id += alphanum[rand() % (sizeof(alphanum) - 1)];
+    char id[VEHICLE_ID_LEN];
+    for (int i = 0; i < VEHICLE_ID_LEN; ++i) {
+        id[i] = alphanum[rand() % (sizeof(alphanum) - 1)];
     }
-    return id;
+    return packVehicleID(id, VEHICLE_ID_LEN);
+}
+
+// Picks a vehicle class: mostly normal traffic, some transit, rare emergencies
+uint8_t generateVehicleClass() {
+    int roll = rand() % 100;
+    if (roll < 2) return CLASS_EMERGENCY;
+    if (roll < 10) return CLASS_TRANSIT;
+    return CLASS_NORMAL;
 }
 
 int main() {
@@ -25,7 +35,6 @@ int main() {
 
     // Lane files
     std::string laneFiles[] = {"lanea.txt", "laneb.txt", "lanec.txt", "laned.txt"};
-    std::string laneNames[] = {"AL2", "BL2", "CL2", "DL2"};
 
     int vehicleCount = 0;
 
@@ -35,20 +44,19 @@ int main() {
         std::this_thread::sleep_for(std::chrono::seconds(delay));
 
         // Select random lane
-        int laneIndex = rand() % 4;
+        int laneIndex = rand() % NUM_LANES;
 
         // Generate vehicle
-        std::string vehicleID = generateVehicleID();
-        time_t currentTime = time(nullptr);
+        Vehicle v(generateVehicleID(), time(nullptr), (uint8_t)laneIndex, generateVehicleClass());
 
         // Write to lane file
         std::ofstream outFile(laneFiles[laneIndex], std::ios::app);
         if (outFile.is_open()) {
-            outFile << vehicleID << "," << currentTime << "," << laneNames[laneIndex] << std::endl;
+            outFile << v.idString() << "," << v.arrivalTime << "," << v.laneLabel() << "," << v.classLabel() << std::endl;
             outFile.close();
 
             vehicleCount++;
-            std::cout << "Vehicle " << vehicleID << " generated on " << laneNames[laneIndex]
+            std::cout << "Vehicle " << v << " (" << v.classLabel() << ") generated on " << v.laneLabel()
                       << " (Total: " << vehicleCount << ")" << std::endl;
         } else {
             std::cerr << "Error: Could not open file " << laneFiles[laneIndex] << std::endl;